@@ -0,0 +1,214 @@
+/**************************************************************************
+**
+** Copyright (c) 2014 Carel Combrink
+**
+** This file is part of the SpellChecker Plugin, a Qt Creator plugin.
+**
+** The SpellChecker Plugin is free software: you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public License as
+** published by the Free Software Foundation, either version 3 of the
+** License, or (at your option) any later version.
+**
+** The SpellChecker Plugin is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with the SpellChecker Plugin.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include "FileTable.h"
+
+#include <QHash>
+#include <QReadWriteLock>
+#include <QVector>
+
+#include <algorithm>
+#include <bit>
+
+using namespace SpellChecker;
+
+namespace {
+/*! \brief Storage of the FileTable. */
+class FileTableStorage
+{
+public:
+  QReadWriteLock lock;
+  QHash<QString, FileId> ids;
+  QVector<QString> fileNames{ QString() }; /*!< Index 0 is the invalid id. */
+};
+
+FileTableStorage& storage()
+{
+  static FileTableStorage table;
+  return table;
+}
+} // namespace
+
+FileId FileTable::id( const QString& fileName )
+{
+  FileTableStorage& table = storage();
+  {
+    QReadLocker locker( &table.lock );
+    const QHash<QString, FileId>::ConstIterator iter = table.ids.constFind( fileName );
+    if( iter != table.ids.constEnd() ) {
+      return iter.value();
+    }
+  }
+  QWriteLocker locker( &table.lock );
+  /* Another thread could have added the file between the locks. */
+  const QHash<QString, FileId>::ConstIterator iter = table.ids.constFind( fileName );
+  if( iter != table.ids.constEnd() ) {
+    return iter.value();
+  }
+  const FileId id = FileId( table.fileNames.size() );
+  table.fileNames.append( fileName );
+  table.ids.insert( fileName, id );
+  return id;
+}
+// --------------------------------------------------
+
+FileId FileTable::find( const QString& fileName )
+{
+  FileTableStorage& table = storage();
+  QReadLocker locker( &table.lock );
+  return table.ids.value( fileName, cINVALID_FILE_ID );
+}
+// --------------------------------------------------
+
+QString FileTable::fileName( FileId id )
+{
+  FileTableStorage& table = storage();
+  QReadLocker locker( &table.lock );
+  if( id >= FileId( table.fileNames.size() ) ) {
+    return QString();
+  }
+  return table.fileNames.at( id );
+}
+// --------------------------------------------------
+
+FileIdSet FileIdSet::fromFileNames( const QSet<QString>& fileNames )
+{
+  FileIdSet set;
+  for( const QString& fileName: fileNames ) {
+    set.insert( FileTable::id( fileName ) );
+  }
+  return set;
+}
+// --------------------------------------------------
+
+QSet<QString> FileIdSet::fileNames() const
+{
+  QSet<QString> names;
+  names.reserve( d_count );
+  forEach( [&names]( FileId id ) {
+    names.insert( FileTable::fileName( id ) );
+  } );
+  return names;
+}
+// --------------------------------------------------
+
+void FileIdSet::insert( FileId id )
+{
+  if( id == cINVALID_FILE_ID ) {
+    return;
+  }
+  const size_t index = id / cBITS;
+  if( index >= d_bits.size() ) {
+    d_bits.resize( index + 1, 0 );
+  }
+  if( ( d_bits[index] & bit( id ) ) == 0 ) {
+    d_bits[index] |= bit( id );
+    ++d_count;
+  }
+}
+// --------------------------------------------------
+
+bool FileIdSet::remove( FileId id )
+{
+  if( contains( id ) == false ) {
+    return false;
+  }
+  d_bits[id / cBITS] &= ~bit( id );
+  --d_count;
+  return true;
+}
+// --------------------------------------------------
+
+void FileIdSet::clear()
+{
+  d_bits.clear();
+  d_count = 0;
+}
+// --------------------------------------------------
+
+FileId FileIdSet::first() const
+{
+  for( size_t index = 0; index < d_bits.size(); ++index ) {
+    if( d_bits[index] != 0 ) {
+      return FileId( index * cBITS ) + FileId( countTrailingZeros( d_bits[index] ) );
+    }
+  }
+  return cINVALID_FILE_ID;
+}
+// --------------------------------------------------
+
+FileIdSet& FileIdSet::operator|=( const FileIdSet& other )
+{
+  if( other.d_bits.size() > d_bits.size() ) {
+    d_bits.resize( other.d_bits.size(), 0 );
+  }
+  for( size_t index = 0; index < other.d_bits.size(); ++index ) {
+    d_bits[index] |= other.d_bits[index];
+  }
+  recount();
+  return *this;
+}
+// --------------------------------------------------
+
+FileIdSet& FileIdSet::operator-=( const FileIdSet& other )
+{
+  const size_t size = std::min( d_bits.size(), other.d_bits.size() );
+  for( size_t index = 0; index < size; ++index ) {
+    d_bits[index] &= ~other.d_bits[index];
+  }
+  recount();
+  return *this;
+}
+// --------------------------------------------------
+
+FileIdSet FileIdSet::operator-( const FileIdSet& other ) const
+{
+  FileIdSet difference = *this;
+  difference -= other;
+  return difference;
+}
+// --------------------------------------------------
+
+bool FileIdSet::operator==( const FileIdSet& other ) const
+{
+  if( d_count != other.d_count ) {
+    return false;
+  }
+  /* Trailing words without bits do not make the sets different. */
+  const size_t size = std::min( d_bits.size(), other.d_bits.size() );
+  return std::equal( d_bits.cbegin(), d_bits.cbegin() + ptrdiff_t( size ), other.d_bits.cbegin() );
+}
+// --------------------------------------------------
+
+int32_t FileIdSet::countTrailingZeros( quint64 bits )
+{
+  return int32_t( std::countr_zero( bits ) );
+}
+// --------------------------------------------------
+
+void FileIdSet::recount()
+{
+  d_count = 0;
+  for( const quint64 bits: d_bits ) {
+    d_count += int32_t( std::popcount( bits ) );
+  }
+}
+// --------------------------------------------------
@@ -0,0 +1,139 @@
+/**************************************************************************
+**
+** Copyright (c) 2014 Carel Combrink
+**
+** This file is part of the SpellChecker Plugin, a Qt Creator plugin.
+**
+** The SpellChecker Plugin is free software: you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public License as
+** published by the Free Software Foundation, either version 3 of the
+** License, or (at your option) any later version.
+**
+** The SpellChecker Plugin is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with the SpellChecker Plugin.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#pragma once
+
+#include <QSet>
+#include <QString>
+
+#include <cstdint>
+#include <vector>
+
+namespace SpellChecker {
+
+/*! \brief Identifier of a file in the FileTable. */
+using FileId = quint32;
+/*! \brief FileId that does not refer to a file. */
+constexpr FileId cINVALID_FILE_ID = 0;
+
+/*! \brief The FileTable class
+ *
+ * Table of all file names that words were parsed from. Words refer to their
+ * file using the FileId instead of each word storing a copy of the name of
+ * the file.
+ *
+ * Files are only ever added to the table, an id stays valid for the lifetime
+ * of the plugin. All functions are thread safe. */
+class FileTable
+{
+public:
+  /*! \brief Get the id of the file, the file is added if it is not in the table yet. */
+  static FileId id( const QString& fileName );
+  /*! \brief Get the id of the file without adding it to the table.
+   *
+   * Returns cINVALID_FILE_ID if the file is not in the table. */
+  static FileId find( const QString& fileName );
+  /*! \brief Get the name of the file with the given id.
+   *
+   * Returns an empty string for an invalid id. */
+  static QString fileName( FileId id );
+};
+// --------------------------------------------------
+// --------------------------------------------------
+// --------------------------------------------------
+
+/*! \brief The FileIdSet class
+ *
+ * Set of files stored as a bitset indexed by the FileId of each file. Since
+ * the ids are dense, a set of all files of a project costs one bit per file
+ * and the difference or union of two sets is done a word of bits at a time
+ * instead of hashing the names of the files.
+ *
+ * The set is a value type and is not thread safe. */
+class FileIdSet
+{
+public:
+  /*! \brief Constructor, creates an empty set. */
+  FileIdSet() = default;
+  /*! \brief Create a set of the given \a fileNames, adding them to the FileTable as needed. */
+  static FileIdSet fromFileNames( const QSet<QString>& fileNames );
+  /*! \brief Get the names of the files in the set. */
+  QSet<QString> fileNames() const;
+
+  /*! \brief Check if the file with the given \a id is in the set. */
+  bool contains( FileId id ) const
+  {
+    const size_t index = id / cBITS;
+    return ( index < d_bits.size() )
+           && ( ( d_bits[index] & bit( id ) ) != 0 );
+  }
+  /*! \brief Check if the file \a fileName is in the set. */
+  bool contains( const QString& fileName ) const
+  {
+    return contains( FileTable::find( fileName ) );
+  }
+  /*! \brief Add the file with the given \a id to the set. */
+  void insert( FileId id );
+  /*! \brief Remove the file with the given \a id from the set.
+   * \return true if the file was in the set. */
+  bool remove( FileId id );
+  /*! \brief Remove all files from the set. */
+  void clear();
+  /*! \brief Check if the set is empty. */
+  bool isEmpty() const { return d_count == 0; }
+  /*! \brief Number of files in the set. */
+  int32_t count() const { return d_count; }
+  /*! \brief Get the file with the lowest id in the set, cINVALID_FILE_ID if empty. */
+  FileId first() const;
+  /*! \brief Call \a function with the id of each file in the set, lowest id first. */
+  template<typename Function>
+  void forEach( Function function ) const
+  {
+    for( size_t index = 0; index < d_bits.size(); ++index ) {
+      quint64 bits = d_bits[index];
+      while( bits != 0 ) {
+        const FileId id = FileId( index * cBITS ) + FileId( countTrailingZeros( bits ) );
+        bits           &= ( bits - 1 );
+        function( id );
+      }
+    }
+  }
+
+  /*! \brief Add the files of \a other to the set. */
+  FileIdSet& operator|=( const FileIdSet& other );
+  /*! \brief Remove the files of \a other from the set. */
+  FileIdSet& operator-=( const FileIdSet& other );
+  /*! \brief Get the files that are in the set but not in \a other. */
+  FileIdSet operator-( const FileIdSet& other ) const;
+  bool operator==( const FileIdSet& other ) const;
+
+private:
+  static constexpr size_t cBITS = 64;
+  static quint64 bit( FileId id ) { return quint64( 1 ) << ( id % cBITS ); }
+  static int32_t countTrailingZeros( quint64 bits );
+  /*! \brief Count the files after the bits were changed in bulk. */
+  void recount();
+
+  std::vector<quint64> d_bits; /*!< Bit of each FileId, set if the file is in the set. */
+  int32_t d_count = 0;         /*!< Number of bits that are set. */
+};
+
+} // namespace SpellChecker
@@ -20,6 +20,9 @@
 
 #include "ISpellChecker.h"
 #include "Word.h"
+#include "spellcheckercore.h"
+
+#include <QHash>
 
 // #define BENCH_TIME
 #ifdef BENCH_TIME
@@ -28,11 +31,12 @@
 
 using namespace SpellChecker;
 
-SpellCheckProcessor::SpellCheckProcessor( ISpellChecker* spellChecker, const QString& fileName, const WordList& wordList, const WordList& previousMistakes )
+SpellCheckProcessor::SpellCheckProcessor( ISpellChecker* spellChecker, const QString& fileName, const WordList& wordList, const WordList& previousMistakes, quint64 verdictGeneration )
   : d_spellChecker( spellChecker )
   , d_fileName( fileName )
   , d_wordList( wordList )
   , d_previousMistakes( previousMistakes )
+  , d_verdictGeneration( verdictGeneration )
 {}
 // --------------------------------------------------
 
@@ -45,15 +49,22 @@ void SpellCheckProcessor::process( QPromise<WordList>& promise )
   QElapsedTimer timer;
   timer.start();
 #endif /* BENCH_TIME */
-  WordListConstIter misspelledIter;
   WordListConstIter prevMisspelledIter;
+  /* Suggestions of the mistakes that were already found in this pass of the
+   * file. Kept apart from the list of mistakes so that the lookups do not
+   * depend on the type of the word list. */
+  QHash<QString, QStringList> suggestionsInFile;
+  QHash<QString, QStringList>::ConstIterator suggestionsIter;
   Word misspelledWord;
   WordList misspelledWords;
   WordList words             = d_wordList;
   WordListConstIter wordIter = words.constBegin();
   bool spellingMistake;
+  /* Words or spell checkers might have changed since the parser judged the
+   * words that it marked as checked, then they are checked again. */
+  const bool verdictsValid = ( d_verdictGeneration == SpellCheckerCore::instance()->dictionaryGeneration() );
   promise.setProgressRange( 0, words.count() + 1 );
-  while( wordIter != d_wordList.constEnd() ) {
+  while( wordIter != words.constEnd() ) {
     /* Get the word at the current iterator position.
      * After this is done, move the iterator to the next position and
      * increment the progress value. This is done so that one can call
@@ -67,6 +78,14 @@ void SpellCheckProcessor::process( QPromise<WordList>& promise )
     if( promise.isCanceled() == true ) {
       return;
     }
+    if( ( misspelledWord.checked == true )
+        && ( verdictsValid == true ) ) {
+      /* The word comes from a token that did not change since it was
+       * checked, the parser passed on the verdict and the suggestions. */
+      misspelledWord.text = internText( misspelledWord.text );
+      misspelledWords.append( misspelledWord );
+      continue;
+    }
     spellingMistake = d_spellChecker->isSpellingMistake( misspelledWord.text );
     /* Check to see if the char after the word is a period. If it is,
      * add the period to the word an see if it passes the checker. */
@@ -77,6 +96,9 @@ void SpellCheckProcessor::process( QPromise<WordList>& promise )
     }
 
     if( spellingMistake == true ) {
+      /* The mistake is kept for the project, share its text with all other
+       * mistakes with the same text. */
+      misspelledWord.text = internText( misspelledWord.text );
       /* The word is a spelling mistake, check if the word was a mistake
        * the previous time that this file was processed. If it was the
        * suggestions can be reused without having to get the suggestions
@@ -95,9 +117,9 @@ void SpellCheckProcessor::process( QPromise<WordList>& promise )
        * the file since the time to get suggestions is rather slow.
        * If there are no repeating mistakes then this might add unneeded
        * overhead. */
-      misspelledIter = misspelledWords.constFind( misspelledWord.text );
-      if( misspelledIter != misspelledWords.constEnd() ) {
-        misspelledWord.suggestions = ( *misspelledIter ).suggestions;
+      suggestionsIter = suggestionsInFile.constFind( misspelledWord.text );
+      if( suggestionsIter != suggestionsInFile.constEnd() ) {
+        misspelledWord.suggestions = suggestionsIter.value();
         /* Add the word to the local list of misspelled words. */
         misspelledWords.append( misspelledWord );
         continue;
@@ -111,6 +133,7 @@ void SpellCheckProcessor::process( QPromise<WordList>& promise )
        * a mistake in the previous pass of the file nor did the word occur previously
        * in this file, use the spell checker to get the suggestions for the word. */
       d_spellChecker->getSuggestionsForWord( misspelledWord.text, misspelledWord.suggestions );
+      suggestionsInFile.insert( misspelledWord.text, misspelledWord.suggestions );
       /* Add the word to the local list of misspelled words. */
       misspelledWords.append( misspelledWord );
     }
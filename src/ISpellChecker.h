@@ -103,6 +103,9 @@ public:
  * The chance that a word repeats in a file is big for different passes and the
  * time for a spell checker to get suggestions can be rather slow.
  *
+ * Words that are marked as Word::checked are mistakes that the parser already
+ * knows the verdict of, they are passed through without using the spell checker.
+ *
  * This process can be cancelled by cancelling the future. */
 class SpellCheckProcessor
   : public QObject
@@ -117,8 +120,11 @@ public:
    * \param[in] fileName Name of the file that the given words to be checked belongs to.
    * \param[in] wordList Words that must be checked for possible spelling mistakes.
    * \param[in] previousMistakes List of words that were identified as spelling mistakes in
-   *      the previous processing run of the current file.*/
-  SpellCheckProcessor( ISpellChecker* spellChecker, const QString& fileName, const WordList& wordList, const WordList& previousMistakes );
+   *      the previous processing run of the current file.
+   * \param[in] verdictGeneration Generation of the dictionary that the words marked as
+   *      Word::checked were judged with. If the dictionary changed since, the words are
+   *      checked again.*/
+  SpellCheckProcessor( ISpellChecker* spellChecker, const QString& fileName, const WordList& wordList, const WordList& previousMistakes, quint64 verdictGeneration );
   ~SpellCheckProcessor() override;
   /*! Function that will run in the background/thread. */
   void process(QPromise<WordList>& promise );
@@ -127,6 +133,7 @@ protected:
   QString  d_fileName;
   WordList d_wordList;
   WordList d_previousMistakes;
+  quint64  d_verdictGeneration;
 };
 
 } // namespace SpellChecker
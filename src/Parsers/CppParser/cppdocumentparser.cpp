@@ -18,6 +18,8 @@
 ** along with the SpellChecker Plugin.  If not, see <http://www.gnu.org/licenses/>.
 ****************************************************************************/
 
+#include "../../Pipeline.h"
+#include "../../SharedSnapshot.h"
 #include "../../spellcheckerconstants.h"
 #include "../../spellcheckercore.h"
 #include "../../spellcheckercoresettings.h"
@@ -45,14 +47,21 @@
 #include <utils/async.h>
 
 #include <QApplication>
+#include <QElapsedTimer>
 #include <QFutureWatcher>
 #include <QRegularExpression>
 #include <QTextBlock>
 
+#include <array>
+#include <vector>
+
 /*! \brief Testing assert that should be used during debugging
  * but should not be made part of a release. */
 // #define SP_CHECK( test ) QTC_CHECK( test )
 #define SP_CHECK( test )
+/* Define to report the time spent waiting on the locks of the parser each
+ * time that all files of the project were parsed. */
+// #define BENCH_LOCKS
 
 namespace SpellChecker {
 namespace CppSpellChecker {
@@ -65,6 +74,77 @@ const char MIME_TYPE_CXX_DOX[] = "text/x-c++dox";
 /*! Task index name for the C++ document parser progress notification. */
 const char TASK_INDEX[] = "SpellChecker.Task.CppParse";
 
+// --------------------------------------------------
+// --------------------------------------------------
+// --------------------------------------------------
+#ifdef BENCH_LOCKS
+/*! \brief Statistics of the waits on a ParserMutex. */
+struct LockStatistics
+{
+  int64_t acquired  = 0; /*!< Number of times that the lock was taken. */
+  int64_t contended = 0; /*!< Number of times that the lock was held by another thread. */
+  int64_t waitedNs  = 0; /*!< Total time waited for the lock. */
+  int64_t maxWaitNs = 0; /*!< Longest single wait for the lock. */
+
+  LockStatistics& operator+=( const LockStatistics& other )
+  {
+    acquired  += other.acquired;
+    contended += other.contended;
+    waitedNs  += other.waitedNs;
+    maxWaitNs  = std::max( maxWaitNs, other.maxWaitNs );
+    return *this;
+  }
+  void report( const char* name ) const
+  {
+    qDebug() << "Lock: " << name
+             << "\n  - acquired: " << acquired
+             << "\n  - contended: " << contended
+             << "\n  - waited: " << ( waitedNs / 1000 ) << "us"
+             << "\n  - max wait: " << ( maxWaitNs / 1000 ) << "us";
+  }
+};
+
+/*! \brief Mutex that measures the time that threads wait for it.
+ *
+ * The lock is first tried without waiting, only if another thread holds it
+ * the wait is timed. The statistics are only touched while the lock is held. */
+class ParserMutex
+{
+public:
+  void lock()
+  {
+    if( d_mutex.tryLock() == false ) {
+      QElapsedTimer timer;
+      timer.start();
+      d_mutex.lock();
+      const int64_t waitedNs = timer.nsecsElapsed();
+      ++d_statistics.contended;
+      d_statistics.waitedNs += waitedNs;
+      d_statistics.maxWaitNs = std::max( d_statistics.maxWaitNs, waitedNs );
+    }
+    ++d_statistics.acquired;
+  }
+  void unlock()
+  {
+    d_mutex.unlock();
+  }
+  /*! \brief Get and reset the statistics of the lock. */
+  LockStatistics takeStatistics()
+  {
+    lock();
+    const LockStatistics statistics = d_statistics;
+    d_statistics = LockStatistics();
+    unlock();
+    return statistics;
+  }
+private:
+  QMutex d_mutex;
+  LockStatistics d_statistics;
+};
+#else /* BENCH_LOCKS */
+/*! \brief Mutex of the parser, only measured if BENCH_LOCKS is defined. */
+using ParserMutex = QMutex;
+#endif /* BENCH_LOCKS */
 // --------------------------------------------------
 // --------------------------------------------------
 // --------------------------------------------------
@@ -76,7 +156,12 @@ const char TASK_INDEX[] = "SpellChecker.Task.CppParse";
  *
  * This should allow for better maintainability by removing the burden of
  * locking from the user completely and placing it on the maintainer of this
- * class. */
+ * class.
+ *
+ * The hashes are published as immutable snapshots. Readers, the threads of the
+ * code model starting processors, only take a reference to the latest snapshot
+ * and never wait on the writers. Writers build a new hash from the latest
+ * snapshot and publish it, the lock only serialises the writers. */
 class LockedTokenHash
 {
   LockedTokenHash( const LockedTokenHash& other )      = delete;
@@ -84,12 +169,10 @@ class LockedTokenHash
 public:
   /*! \brief Constructor. */
   LockedTokenHash() = default;
-  /*! \brief Get a copy of the HashWords. */
+  /*! \brief Get the latest HashWords. */
   HashWords get() const
   {
-    QMutexLocker locker( &d_mutex );
-    HashWords words = d_tokenHashes;
-    return words;
+    return d_snapshot.load()->value();
   }
   /*! \brief Clear the hash words.
    *
@@ -98,19 +181,268 @@ public:
    * for clearness sake the function is kept. */
   void clear()
   {
-    QMutexLocker locker( &d_mutex );
-    d_tokenHashes.clear();
+    QMutexLocker locker( &d_writeMutex );
+    d_snapshot.publish( HashWords() );
   }
   /*! \brief Assign a HashWords to the internal hashes. */
   void operator=( const HashWords& other )
+  {
+    QMutexLocker locker( &d_writeMutex );
+    d_snapshot.publish( other );
+  }
+  /*! \brief Keep the verdicts of the spell checker for the tokens.
+   *
+   * A token only gets a verdict if all of its words were in the \a words that
+   * were checked, the words are matched on their position and text. Tokens with
+   * words that were not checked, for example because they were removed as
+   * identifiers of the project, are checked again the next time. */
+  void setVerdicts( const WordList& words, const WordList& mistakes, quint64 generation )
+  {
+    const auto positionKey = []( const Word& word ) {
+      return ( quint64( uint32_t( word.lineNumber ) ) << 32 ) | uint32_t( word.columnNumber );
+    };
+    QHash<quint64, QString> checked;
+    checked.reserve( words.size() );
+    for( const Word& word: words ) {
+      checked.insert( positionKey( word ), word.text );
+    }
+    QHash<quint64, Word> mistakesAt;
+    mistakesAt.reserve( mistakes.size() );
+    for( const Word& word: mistakes ) {
+      mistakesAt.insert( positionKey( word ), word );
+    }
+
+    QMutexLocker locker( &d_writeMutex );
+    HashWords tokenHashes = d_snapshot.load()->value();
+    bool changed          = false;
+    for( TokenWords& token: tokenHashes ) {
+      if( ( token.generation == generation )
+          || ( token.filtered == false ) ) {
+        continue;
+      }
+      bool allChecked = true;
+      WordList tokenMistakes;
+      for( const Word& word: qAsConst( token.words ) ) {
+        const quint64 key = positionKey( word );
+        const QHash<quint64, QString>::const_iterator checkedIter = checked.constFind( key );
+        if( ( checkedIter == checked.constEnd() )
+            || ( checkedIter.value() != word.text ) ) {
+          allChecked = false;
+          break;
+        }
+        const QHash<quint64, Word>::const_iterator mistakeIter = mistakesAt.constFind( key );
+        if( mistakeIter != mistakesAt.constEnd() ) {
+          tokenMistakes.append( mistakeIter.value() );
+        }
+      }
+      if( allChecked == true ) {
+        token.mistakes   = tokenMistakes;
+        token.generation = generation;
+        changed          = true;
+      }
+    }
+    if( changed == true ) {
+      d_snapshot.publish( std::move( tokenHashes ) );
+    }
+  }
+  /*! \brief Mark the words of all tokens to be filtered again.
+   *
+   * Used when the settings that filter words changed. The words extracted
+   * from the tokens are still valid, only the settings must be applied to
+   * them again. The verdicts are dropped along with the filtered words.
+   * Tokens that have words but did not keep the words before the settings
+   * were applied are dropped, their words are extracted again. */
+  void resetFilters()
+  {
+    QMutexLocker locker( &d_writeMutex );
+    HashWords tokenHashes = d_snapshot.load()->value();
+    for( HashWords::Iterator iter = tokenHashes.begin(); iter != tokenHashes.end(); ) {
+      TokenWords& token = iter.value();
+      if( ( token.rawWords.isEmpty() == true )
+          && ( token.words.isEmpty() == false ) ) {
+        iter = tokenHashes.erase( iter );
+        continue;
+      }
+      token.words      = token.rawWords;
+      token.filtered   = false;
+      token.mistakes   = WordList();
+      token.generation = 0;
+      ++iter;
+    }
+    d_snapshot.publish( std::move( tokenHashes ) );
+  }
+#ifdef BENCH_LOCKS
+  /*! \brief Get and reset the statistics of the lock of the writers. */
+  LockStatistics takeLockStatistics() { return d_writeMutex.takeStatistics(); }
+#endif /* BENCH_LOCKS */
+
+private:
+  SharedSnapshot<HashWords> d_snapshot; /*!< Latest snapshot of the hashes. */
+  ParserMutex d_writeMutex;             /*!< The lock that serialises the writers. */
+};
+
+/*! \brief Wrapper for the SourceWords to ensure proper locking.
+ *
+ * Same as the LockedTokenHash, for the words that appear in the source of the
+ * current file. */
+class LockedSourceWords
+{
+  LockedSourceWords( const LockedSourceWords& other )      = delete;
+  LockedSourceWords& operator=( const LockedSourceWords& ) = delete;
+public:
+  /*! \brief Constructor. */
+  LockedSourceWords() = default;
+  /*! \brief Get a copy of the SourceWords. */
+  SourceWords get() const
+  {
+    QMutexLocker locker( &d_mutex );
+    return d_sourceWords;
+  }
+  /*! \brief Clear the source words. */
+  void clear()
+  {
+    QMutexLocker locker( &d_mutex );
+    d_sourceWords = SourceWords();
+  }
+  /*! \brief Assign a SourceWords to the internal words. */
+  void operator=( const SourceWords& other )
+  {
+    QMutexLocker locker( &d_mutex );
+    d_sourceWords = other;
+  }
+
+private:
+  SourceWords d_sourceWords; /*!< The SourceWords that are protected. */
+  mutable QMutex d_mutex;    /*!< The lock that guards the words. */
+};
+
+/*! \brief The ProjectIdentifiers class
+ *
+ * Identifiers that appear in the source of the files of the project. The
+ * index is updated incrementally with the words that appear in the source of
+ * each file as the files are parsed. This way a class name from another
+ * header is not reported as a spelling mistake.
+ *
+ * The identifiers of each file are kept as a sorted list so that an update
+ * only touches the identifiers that were added or removed in the file. Each
+ * identifier is counted for the number of files it appears in. The texts of
+ * the identifiers are interned, the same identifier from different files
+ * shares its data.
+ *
+ * The processors get a read only snapshot of the identifiers. A snapshot is
+ * only created if the identifiers changed and the previous snapshot is old
+ * enough, every new snapshot costs a copy of the set when the identifiers are
+ * changed after it. All functions are thread safe. */
+class ProjectIdentifiers
+{
+  ProjectIdentifiers( const ProjectIdentifiers& )            = delete;
+  ProjectIdentifiers& operator=( const ProjectIdentifiers& ) = delete;
+public:
+  /*! \brief Constructor. */
+  ProjectIdentifiers() = default;
+  /*! \brief Set the \a words that appear in the source of the file \a fileName. */
+  void update( const QString& fileName, const QStringSet& words )
+  {
+    QStringList newWords( words.cbegin(), words.cend() );
+    std::sort( newWords.begin(), newWords.end() );
+    QMutexLocker locker( &d_mutex );
+    QStringList& fileWords = d_fileWords[FileTable::id( fileName )];
+    /* Walk the sorted lists together, identifiers that are in both lists
+     * keep their interned text. */
+    auto oldIter = fileWords.cbegin();
+    for( QString& word: newWords ) {
+      while( ( oldIter != fileWords.cend() )
+             && ( *oldIter < word ) ) {
+        release( *oldIter );
+        ++oldIter;
+      }
+      if( ( oldIter != fileWords.cend() )
+          && ( *oldIter == word ) ) {
+        word = *oldIter;
+        ++oldIter;
+      } else {
+        word = internText( word );
+        acquire( word );
+      }
+    }
+    for( ; oldIter != fileWords.cend(); ++oldIter ) {
+      release( *oldIter );
+    }
+    fileWords = std::move( newWords );
+  }
+  /*! \brief Remove the identifiers of the file \a fileName. */
+  void removeFile( const QString& fileName )
+  {
+    QMutexLocker locker( &d_mutex );
+    const auto fileIter = d_fileWords.constFind( FileTable::id( fileName ) );
+    if( fileIter == d_fileWords.constEnd() ) {
+      return;
+    }
+    for( const QString& word: fileIter.value() ) {
+      release( word );
+    }
+    d_fileWords.erase( fileIter );
+  }
+  /*! \brief Remove all identifiers. */
+  void clear()
   {
     QMutexLocker locker( &d_mutex );
-    d_tokenHashes = other;
+    d_fileWords.clear();
+    d_counts.clear();
+    d_identifiers.clear();
+    d_snapshot.reset();
+    d_changed = false;
+  }
+  /*! \brief Get a snapshot of the identifiers of the project.
+   *
+   * The snapshot can be a bit older than the latest update. */
+  IdentifierSetPtr snapshot()
+  {
+    /* Minimum time between new snapshots while the identifiers change. */
+    constexpr qint64 cSNAPSHOT_INTERVAL_MS = 1000;
+    QMutexLocker locker( &d_mutex );
+    if( ( d_changed == true )
+        && ( ( d_snapshot == nullptr )
+             || ( d_snapshotTimer.hasExpired( cSNAPSHOT_INTERVAL_MS ) == true ) ) ) {
+      d_snapshot = std::make_shared<const QStringSet>( d_identifiers );
+      d_changed  = false;
+      d_snapshotTimer.start();
+    }
+    return d_snapshot;
   }
 
 private:
-  HashWords d_tokenHashes; /*!< The HashWords that are protected. */
-  mutable QMutex d_mutex;  /*!< The lock that guards the hashes. */
+  /*! \brief Count a file for the \a word. Called with the mutex locked. */
+  void acquire( const QString& word )
+  {
+    int32_t& count = d_counts[word];
+    if( count == 0 ) {
+      d_identifiers.insert( word );
+      d_changed = true;
+    }
+    ++count;
+  }
+  /*! \brief Remove a file from the count of the \a word. Called with the mutex locked. */
+  void release( const QString& word )
+  {
+    const auto countIter = d_counts.find( word );
+    if( countIter == d_counts.end() ) {
+      return;
+    }
+    if( --countIter.value() == 0 ) {
+      d_counts.erase( countIter );
+      d_identifiers.remove( word );
+      d_changed = true;
+    }
+  }
+
+  QHash<FileId, QStringList> d_fileWords; /*!< Sorted identifiers of each file. */
+  QHash<QString, int32_t> d_counts;       /*!< Number of files that each identifier appears in. */
+  QStringSet d_identifiers;               /*!< All identifiers of the project. */
+  IdentifierSetPtr d_snapshot;            /*!< Last snapshot handed out. */
+  QElapsedTimer d_snapshotTimer;          /*!< Time since the last snapshot was created. */
+  bool d_changed = false;                 /*!< If the identifiers changed since the last snapshot. */
+  mutable QMutex d_mutex;                 /*!< The lock that guards the members. */
 };
 
 /*! \brief The ProgressNotification Wrapper.
@@ -218,9 +550,8 @@ private:
 class FutureWatchers
 {
   /* Using declarations to simplify the code a bit. */
-  using FutureWatcher        = CppDocumentProcessor::WatcherPtr;
-  using FutureWatcherMap     = QMap<FutureWatcher, QString>;
-  using FutureWatcherMapIter = FutureWatcherMap::Iterator;
+  using FutureWatcher    = CppDocumentProcessor::WatcherPtr;
+  using FutureWatcherMap = QHash<FutureWatcher, QString>;
   /* Prevent copy and assignment */
   FutureWatchers( const FutureWatchers& )            = delete;
   FutureWatchers& operator=( const FutureWatchers& ) = delete;
@@ -230,8 +561,9 @@ public:
   /*! \brief Add a new \a watcher and with its \a fileName. */
   void add( CppDocumentProcessor::WatcherPtr watcher, const QString& fileName )
   {
-    QMutexLocker locker( &d_mutex );
-    d_futureWatchers.insert( watcher, fileName );
+    Shard& shard = shardOf( watcher );
+    QMutexLocker locker( &shard.mutex );
+    shard.watchers.insert( watcher, fileName );
   }
   /*! \brief Remove a watcher.
    *
@@ -245,39 +577,188 @@ public:
    * remove */
   QString remove( CppDocumentProcessor::WatcherPtr watcher )
   {
-    QMutexLocker locker( &d_mutex );
-    QString fileName;
+    Shard& shard = shardOf( watcher );
+    QMutexLocker locker( &shard.mutex );
     /* Get the file name associated with this future and the misspelled
      * words. */
-    FutureWatcherMapIter iter = d_futureWatchers.find( watcher );
-    SP_CHECK( iter != d_futureWatchers.end() );
-    if( iter != d_futureWatchers.end() ) {
-      fileName = iter.value();
-      d_futureWatchers.erase( iter );
-    }
+    const QString fileName = shard.watchers.take( watcher );
+    SP_CHECK( fileName.isEmpty() == false );
     return fileName;
   }
+  /*! \brief Get the name of the file that the \a watcher is processing.
+   *
+   * The name is empty if the watcher is not in the list. */
+  QString fileName( CppDocumentProcessor::WatcherPtr watcher ) const
+  {
+    const Shard& shard = shardOf( watcher );
+    QMutexLocker locker( &shard.mutex );
+    return shard.watchers.value( watcher );
+  }
   /*! \brief Cancel all futures.
    *
    * This function will block until all futures that were cancelled
    * have finished. The function will also remove all futures from the
-   * list of futures. */
+   * list of futures.
+   *
+   * The watchers are taken out of the shards before they are cancelled,
+   * new watchers can be added while this waits on the cancelled ones. */
   void cancell()
+  {
+    std::vector<FutureWatcher> cancelled;
+    for( Shard& shard: d_shards ) {
+      QMutexLocker locker( &shard.mutex );
+      for( FutureWatcherMap::const_iterator iter = shard.watchers.cbegin(); iter != shard.watchers.cend(); ++iter ) {
+        iter.key()->cancel();
+        cancelled.push_back( iter.key() );
+      }
+      shard.watchers.clear();
+    }
+    for( FutureWatcher watcher: cancelled ) {
+      watcher->waitForFinished();
+    }
+  }
+#ifdef BENCH_LOCKS
+  /*! \brief Get and reset the statistics of the locks of all shards. */
+  LockStatistics takeLockStatistics()
+  {
+    LockStatistics statistics;
+    for( Shard& shard: d_shards ) {
+      statistics += shard.mutex.takeStatistics();
+    }
+    return statistics;
+  }
+#endif /* BENCH_LOCKS */
+private:
+  /*! \brief Number of shards, watchers are added from the threads of the code
+   * model and removed in the GUI thread. */
+  static constexpr size_t cSHARD_COUNT = 8;
+  /*! \brief Shard of the watchers with its own lock. */
+  struct Shard
+  {
+    FutureWatcherMap watchers;   /*!< Watchers of the shard. */
+    mutable ParserMutex mutex;   /*!< The lock that guards the watchers of the shard. */
+  };
+  Shard& shardOf( FutureWatcher watcher )
+  {
+    return d_shards[qHash( watcher ) % cSHARD_COUNT];
+  }
+  const Shard& shardOf( FutureWatcher watcher ) const
+  {
+    return d_shards[qHash( watcher ) % cSHARD_COUNT];
+  }
+  std::array<Shard, cSHARD_COUNT> d_shards; /*!< Shards of the watchers that should be guarded. */
+};
+
+/*! \brief Wrapper for the queue of files that must be parsed.
+ *
+ * Files wait in the queue until they are handed to the code model, and are
+ * then in process until their processor finished. A file moves from one set to
+ * the other in a single step, thus both sets are guarded by the same lock.
+ * The lock is only held for the set operations, the callers do the rest of
+ * their work outside of it.
+ *
+ * The files are kept as sets of the ids of the files, files are taken from
+ * the queue in the order that they were added to the FileTable. */
+class FileQueue
+{
+  FileQueue( const FileQueue& )            = delete;
+  FileQueue& operator=( const FileQueue& ) = delete;
+public:
+  /*! \brief Number of files in the queue. */
+  struct Counts
+  {
+    size_t outstanding = 0; /*!< Files that must still be parsed. */
+    size_t inProcess   = 0; /*!< Files that are being parsed. */
+  };
+  /*! \brief Constructor. */
+  FileQueue() = default;
+  /*! \brief Replace the files to parse with \a files, forgetting the files in process. */
+  void reset( const FileIdSet& files )
   {
     QMutexLocker locker( &d_mutex );
-    for( FutureWatcherMapIter iter = d_futureWatchers.begin(); iter != d_futureWatchers.end(); ++iter ) {
-      /* Can't use range for or std::for_each due to the way that a Qt QMap works... */
-      iter.key()->cancel();
+    d_filesInProcess.clear();
+    d_filesToUpdate = files;
+  }
+  /*! \brief Add \a files that must be parsed. */
+  void add( const FileIdSet& files )
+  {
+    QMutexLocker locker( &d_mutex );
+    d_filesToUpdate |= files;
+  }
+  /*! \brief The code model updated \a fileName.
+   *
+   * The file is no longer waiting. If it will be parsed it is in process,
+   * otherwise it is forgotten.
+   * \return true if there are more files that wait to be parsed. */
+  bool updated( const QString& fileName, bool willParse )
+  {
+    const FileId fileId = FileTable::id( fileName );
+    QMutexLocker locker( &d_mutex );
+    /* Remove from the list to update since it will be updated now */
+    d_filesToUpdate.remove( fileId );
+    /* If the file should not be parsed, remove it from the list of
+     * files in process. This is needed since the take() will add it to
+     * that list when it queues it.
+     * If the file should be parsed, add it to the list of files that
+     * that are in process, this is used to limit the number of files
+     * processed at the same time. */
+    if( willParse == false ) {
+      d_filesInProcess.remove( fileId );
+    } else {
+      d_filesInProcess.insert( fileId );
     }
-    for( FutureWatcherMapIter iter = d_futureWatchers.begin(); iter != d_futureWatchers.end(); ++iter ) {
-      /* Can't use range for or std::for_each due to the way that a Qt QMap works... */
-      iter.key()->waitForFinished();
+    return ( d_filesToUpdate.isEmpty() == false );
+  }
+  /*! \brief The processor of \a fileName finished. */
+  void parsed( const QString& fileName )
+  {
+    const FileId fileId = FileTable::find( fileName );
+    QMutexLocker locker( &d_mutex );
+    d_filesInProcess.remove( fileId );
+  }
+  /*! \brief Take files that wait to be parsed and put them in process.
+   *
+   * Files are taken while there are less than \a capacity files in process and
+   * \a canQueue() returns true. Files for which \a shouldParse() returns false
+   * are dropped from the queue.
+   * \param[out] counts Number of files in the queue after the files were taken.
+   * \return The files that were put in process. */
+  template<typename CanQueue, typename ShouldParse>
+  QSet<Utils::FilePath> take( size_t capacity, CanQueue canQueue, ShouldParse shouldParse, Counts& counts )
+  {
+    QSet<Utils::FilePath> files;
+    QMutexLocker locker( &d_mutex );
+    while( ( size_t( d_filesInProcess.count() ) < capacity )
+           && ( d_filesToUpdate.isEmpty() == false )
+           && ( canQueue() == true ) ) {
+      const FileId fileId = d_filesToUpdate.first();
+      d_filesToUpdate.remove( fileId );
+      const QString file = FileTable::fileName( fileId );
+      if( shouldParse( file ) == true ) {
+        d_filesInProcess.insert( fileId );
+        files.insert( Utils::FilePath::fromString( file ) );
+      }
     }
-    d_futureWatchers.clear();
+    counts.outstanding = size_t( d_filesToUpdate.count() );
+    counts.inProcess   = size_t( d_filesInProcess.count() );
+    return files;
   }
+#ifdef BENCH_LOCKS
+  /*! \brief Get and reset the statistics of the lock of the queue. */
+  LockStatistics takeLockStatistics() { return d_mutex.takeStatistics(); }
+#endif /* BENCH_LOCKS */
 private:
-  FutureWatcherMap d_futureWatchers; /*!< Map of watchers that should be guarded. */
-  mutable QMutex d_mutex;            /*!< The lock that guards the map. */
+  FileIdSet d_filesToUpdate;  /*!< Files added to the waiting queue
+                               * that must still be parsed. The
+                               * CppModelManager must still be instructed
+                               * to parse these files. The idea is not to
+                               * instruct too many at a time since this
+                               * can be an issue for large projects. */
+  FileIdSet d_filesInProcess; /*!< Files that are in process of being
+                               * parsed. Either the CppModelManager was
+                               * instructed to parse the file or there is
+                               * already a future parsing the file. */
+  ParserMutex d_mutex;        /*!< The lock that guards both sets. */
 };
 
 /*! \brief PIMPL of the CppDocumentParser object. */
@@ -288,26 +769,15 @@ public:
   QString currentEditorFileName;
   CppParserSettings settings;
   CppParserOptionsPage optionsPage{&settings};
-  QStringSet filesInStartupProject;
+  SharedSnapshot<CppParserSettings> settingsSnapshot; /*!< Snapshot of the \a settings
+                                        * that is handed to the processors. The
+                                        * generation of the snapshot tells if
+                                        * the results of a processor were
+                                        * created with the latest settings. */
+  FileIdSet filesInStartupProject;
   // --
-  QMutex fileQeueMutex;                /*!< Mutex protecting the filesToUpdate and filesInProcess
-                                        * sets. This should also be added to a wrapper, but for
-                                        * now this will be skipped. */
-  std::set<QString> filesToUpdate;     /*!< Files added to the waiting queue
-                                        * that must still be parsed. The
-                                        * CppModelManager must still be instructed
-                                        * to parse these files. The idea is not to
-                                        * instruct too many at a time since this
-                                        * can be an issue for large projects.
-                                        * A std::set was used to make threading
-                                        * issues clear, compared to a QSet with
-                                        * COW that hides this (and introduces
-                                        * confusion). */
-  std::set<QString> filesInProcess;    /*!< Files that are in process of being
-                                        * parsed. Either the CppModelManager was
-                                        * instructed to parse the file or there is
-                                        * already a future parsing the file.
-                                        * See above for why a std::set was used. */
+  FileQueue fileQueue;                 /*!< Files that must still be parsed and
+                                        * the files that are in process. */
   LockedTokenHash tokenHashes;         /*!< Tokens and their hashes that are
                                         * used to speed up processing the
                                         * current file. The hashes of tokens
@@ -316,10 +786,26 @@ public:
                                         * is encountered, the words can be reused
                                         * without needing to process the token
                                         * again. */
+  LockedSourceWords sourceWords;       /*!< Words that appear in the source of the
+                                        * current file, along with the fingerprint of
+                                        * the code they came from. Edits that do not
+                                        * change the code, like edits in comments, can
+                                        * reuse them without walking the symbols of
+                                        * the file again. */
+  ProjectIdentifiers projectIdentifiers; /*!< Identifiers that appear in the files
+                                        * of the project. Used to remove words that
+                                        * appear in the source of other files. */
+  QHash<QString, quint64> wordsFingerprints; /*!< Fingerprint of the words reported
+                                        * the last time that a file was parsed. Only
+                                        * files with known mistakes have one, that is
+                                        * the current file. Only used in the GUI thread. */
   FutureWatchers futureWatchers;       /*!< List of future watchers created. This
                                         * list is used to cancel the futures as needed
                                         * for example when the application closes down,
                                         * the project changes or the settings changes. */
+  std::shared_ptr<VisibleRange> visibleRange = std::make_shared<VisibleRange>(); /*!< Visible lines of the
+                                        * current editor. The same object is shared with
+                                        * all processors of the current file. */
   ProgressNotification progressObject; /*!< The object pointer for the
                                         * progress indication. It will get
                                         * created and destroyed as needed
@@ -362,21 +848,16 @@ public:
           } );
   }
   // ------------------------------------------
-
-  /*! \brief Utility function to erase a file from the set if the file
-   * is in the set.
-   *
-   * Since std::set::erase() requires a valid iterator (not end(), see
-   * the docs) a check must first be done to check if the \a file was
-   * found or now. */
-  static void eraseIfFound( std::set<QString>& set, const QString& file )
+#ifdef BENCH_LOCKS
+  /*! \brief Report and reset the statistics of the locks of the parser. */
+  void reportLockStatistics()
   {
-    const auto setIter = set.find( file );
-    if( setIter != set.end() ) {
-      set.erase( setIter );
-    }
+    fileQueue.takeLockStatistics().report( "File queue" );
+    futureWatchers.takeLockStatistics().report( "Future watchers" );
+    tokenHashes.takeLockStatistics().report( "Token hash writers" );
   }
   // ------------------------------------------
+#endif /* BENCH_LOCKS */
 };
 // --------------------------------------------------
 // --------------------------------------------------
@@ -388,8 +869,13 @@ CppDocumentParser::CppDocumentParser( QObject* parent )
 {
   /* Create the settings for this parser */
   d->settings.loadFromSettings( Core::ICore::settings() );
+  d->settingsSnapshot.publish( d->settings );
   connect(                &d->settings,               &CppParserSettings::settingsChanged,                                this, &CppDocumentParser::settingsChanged );
   connect( SpellCheckerCore::instance()->settings(), &SpellChecker::Internal::SpellCheckerCoreSettings::settingsChanged, this, &CppDocumentParser::settingsChanged );
+  /* Continue queueing files when the later stages of the pipeline caught up. */
+  connect( SpellCheckerCore::instance()->pipeline(), &Pipeline::capacityAvailable, this, &CppDocumentParser::queueFilesForUpdate, Qt::QueuedConnection );
+  /* Keep the verdicts of the words of the current file for the next parse. */
+  connect( SpellCheckerCore::instance(), &SpellCheckerCore::wordsChecked, this, &CppDocumentParser::wordsChecked );
 
   CppEditor::CppModelManager* modelManager = CppEditor::CppModelManager::instance();
   connect( modelManager, &CppEditor::CppModelManager::documentUpdated, this, &CppDocumentParser::parseCppDocumentOnUpdate, Qt::DirectConnection );
@@ -434,6 +920,7 @@ void CppDocumentParser::setActiveProject( ProjectExplorer::Project* activeProjec
 {
   d->activeProject = activeProject;
   d->filesInStartupProject.clear();
+  d->projectIdentifiers.clear();
 
   /* Call reparseProject() to reset and clean up properly.
    * The logic inside will ensure that parsing is not started again
@@ -444,13 +931,12 @@ void CppDocumentParser::setActiveProject( ProjectExplorer::Project* activeProjec
 
 void CppDocumentParser::updateProjectFiles( QStringSet filesAdded, QStringSet filesRemoved )
 {
-  Q_UNUSED( filesRemoved )
-  const QStringSet fileSet = d->getCppFiles( filesAdded );
-  d->filesInStartupProject.unite( fileSet );
-  {
-    QMutexLocker locker( &d->fileQeueMutex );
-    d->filesToUpdate.insert( fileSet.cbegin(), fileSet.cend() );
+  for( const QString& file: qAsConst( filesRemoved ) ) {
+    d->projectIdentifiers.removeFile( file );
   }
+  const FileIdSet fileSet = FileIdSet::fromFileNames( d->getCppFiles( filesAdded ) );
+  d->filesInStartupProject |= fileSet;
+  d->fileQueue.add( fileSet );
   queueFilesForUpdate();
 }
 // --------------------------------------------------
@@ -458,6 +944,16 @@ void CppDocumentParser::updateProjectFiles( QStringSet filesAdded, QStringSet fi
 void CppDocumentParser::setCurrentEditor( const QString& editorFilePath )
 {
   d->currentEditorFileName = editorFilePath;
+  d->visibleRange->clear();
+}
+// --------------------------------------------------
+
+void CppDocumentParser::setVisibleRange( const QString& editorFilePath, int32_t firstLine, int32_t lastLine )
+{
+  if( editorFilePath != d->currentEditorFileName ) {
+    return;
+  }
+  d->visibleRange->set( firstLine, lastLine );
 }
 // --------------------------------------------------
 
@@ -470,28 +966,10 @@ void CppDocumentParser::parseCppDocumentOnUpdate( CPlusPlus::Document::Ptr docPt
   const QString fileName = docPtr->filePath().path();
   const bool shouldParse = shouldParseDocument( fileName );
 
-  bool queueMore;
-  {
-    QMutexLocker locker( &d->fileQeueMutex );
-    /* Remove from the list to update since it will be updated now */
-    d->eraseIfFound( d->filesToUpdate, fileName );
-    /* Always try to queue more if there are more files to update.
-     * The logic inside queueFilesForUpdate() will ensure that there
-     * are no more added than what is desired. */
-    queueMore = ( d->filesToUpdate.size() > 0 );
-
-    /* If the file should not be parsed, remove it from the list of
-     * files in process. This is needed since the queueFilesForUpdate()
-     * will add it to that list when it queues it.
-     * If the file should be parsed, add it to the list of files that
-     * that are in process, this is used to limit the number of files
-     * processed at the same time. */
-    if( shouldParse == false ) {
-      d->eraseIfFound( d->filesInProcess, fileName );
-    } else {
-      d->filesInProcess.insert( fileName );
-    }
-  }
+  /* Always try to queue more if there are more files to update.
+   * The logic inside queueFilesForUpdate() will ensure that there
+   * are no more added than what is desired. */
+  const bool queueMore = d->fileQueue.updated( fileName, shouldParse );
 
   if( shouldParse == true ) {
     parseCppDocument( std::move( docPtr ) );
@@ -503,10 +981,29 @@ void CppDocumentParser::parseCppDocumentOnUpdate( CPlusPlus::Document::Ptr docPt
 }
 // --------------------------------------------------
 
-void CppDocumentParser::settingsChanged()
+void CppDocumentParser::settingsChanged( SpellChecker::SettingsChanges changes )
 {
-  /* Clear the hashes since all comments must be re parsed. */
-  d->tokenHashes.clear();
+  const SettingsChanges affectsWords = SettingsChanges( SettingsChange::Filter ) | SettingsChange::Extraction | SettingsChange::Structural;
+  if( changes.testAnyFlags( affectsWords ) == false ) {
+    /* Nothing that affects the words of files changed. */
+    return;
+  }
+  /* Publish the settings before parsing again, processors that are still
+   * running keep the snapshot that they were started with. */
+  d->settingsSnapshot.publish( d->settings );
+  if( changes.testFlag( SettingsChange::Structural ) == true ) {
+    /* Clear the hashes since all comments must be re parsed. The words of
+     * files will be different as well. */
+    d->tokenHashes.clear();
+  } else if( changes.testFlag( SettingsChange::Filter ) == true ) {
+    /* The words extracted from the tokens stay the same, only the settings
+     * must be applied to them again. */
+    d->tokenHashes.resetFilters();
+  }
+  /* If only the kind of tokens that are checked changed, the hashes are kept
+   * as is. Tokens that are still checked will be found in the hashes and only
+   * the tokens that are newly checked must be parsed. */
+  d->wordsFingerprints.clear();
   /* Re parse the project */
   reparseProject();
 }
@@ -514,8 +1011,10 @@ void CppDocumentParser::settingsChanged()
 
 void CppDocumentParser::reparseProject()
 {
-  /* Need to cancel all futures in process.
-   * This function call will block until all are cancelled and done. */
+  /* Need to cancel all futures in process. Cancel the stage first so that
+   * jobs that did not start yet return without parsing.
+   * The cancell() call will block until all are cancelled and done. */
+  SpellCheckerCore::instance()->pipeline()->stage( Pipeline::Parse )->cancelAll();
   d->futureWatchers.cancell();
   /* Clear other members. */
   d->filesInStartupProject.clear();
@@ -529,16 +1028,11 @@ void CppDocumentParser::reparseProject()
   const Utils::FilePaths projectFiles = d->activeProject->files( ProjectExplorer::Project::SourceFiles );
   const auto fileList                 = Utils::transform<QStringSet>( projectFiles, &Utils::FilePath::path );
 
-  const QStringSet fileSet = d->getCppFiles( fileList );
+  const FileIdSet fileSet  = FileIdSet::fromFileNames( d->getCppFiles( fileList ) );
   d->filesInStartupProject = fileSet;
 
-  {
-    /* Add the files to the waiting queue and then process the queue */
-    QMutexLocker locker( &d->fileQeueMutex );
-    d->filesInProcess.clear();
-    d->filesToUpdate.clear();
-    d->filesToUpdate = Utils::transform<std::set<QString>>( fileSet, []( const QString& string ) { return string; } );
-  }
+  /* Add the files to the waiting queue and then process the queue */
+  d->fileQueue.reset( fileSet );
 
   queueFilesForUpdate();
 }
@@ -549,28 +1043,28 @@ void CppDocumentParser::queueFilesForUpdate()
   /* Only re-parse the files that were added. */
   static CppEditor::CppModelManager* modelManager = CppEditor::CppModelManager::instance();
 
-  QSet<Utils::FilePath> filesToUpdate;
-  size_t filesOutstanding;
-  size_t filesInProcess;
-
-  {
-    QMutexLocker locker( &d->fileQeueMutex );
-    auto fileIter = d->filesToUpdate.begin();
-    while( ( d->filesInProcess.size() < 10 )
-           && ( d->filesToUpdate.empty() == false ) ) {
-      const QString file = ( *fileIter );
-      fileIter = d->filesToUpdate.erase( fileIter );
-      if( shouldParseDocument( file ) == true ) {
-        d->filesInProcess.insert( file );
-        filesToUpdate.insert( Utils::FilePath::fromString(file) );
-      }
-    }
-
-    filesOutstanding = d->filesToUpdate.size();
-    filesInProcess   = d->filesInProcess.size();
+  const Pipeline* pipeline = SpellCheckerCore::instance()->pipeline();
+  const size_t parseCapacity = size_t( pipeline->stage( Pipeline::Parse )->capacity() );
+
+  /* Limit the files in process to the capacity of the Parse stage, and stop
+   * queueing if the later stages can not keep up. The pipeline will notify
+   * when it has capacity again. */
+  FileQueue::Counts counts;
+  const QSet<Utils::FilePath> filesToUpdate = d->fileQueue.take(
+    parseCapacity,
+    [pipeline]() { return pipeline->hasCapacityFrom( Pipeline::Check ); },
+    [this]( const QString& file ) { return shouldParseDocument( file ); },
+    counts );
+
+  d->progressObject.update( d->filesInStartupProject.count(), int32_t( counts.outstanding ), int32_t( counts.inProcess ) );
+#ifdef BENCH_LOCKS
+  if( ( counts.outstanding == 0 )
+      && ( counts.inProcess == 0 ) ) {
+    /* All files of the project were parsed, report the waits on the locks
+     * while the files were parsed. */
+    d->reportLockStatistics();
   }
-
-  d->progressObject.update( d->filesInStartupProject.count(), int32_t( filesOutstanding ), int32_t( filesInProcess ) );
+#endif /* BENCH_LOCKS */
 
   modelManager->updateSourceFiles( filesToUpdate );
 }
@@ -578,15 +1072,18 @@ void CppDocumentParser::queueFilesForUpdate()
 
 bool CppDocumentParser::shouldParseDocument( const QString& fileName )
 {
-  SpellChecker::Internal::SpellCheckerCoreSettings* settings = SpellCheckerCore::instance()->settings();
-  if( ( settings->onlyParseCurrentFile == true )
+  /* This gets called from the threads of the code model as well, the
+   * snapshot of the settings is used instead of the settings of the core. */
+  const SpellCheckerCore::SettingsSnapshot snapshot             = SpellCheckerCore::instance()->settingsSnapshot();
+  const SpellChecker::Internal::SpellCheckerCoreSettings& settings = snapshot->value();
+  if( ( settings.onlyParseCurrentFile == true )
       && ( d->currentEditorFileName != fileName ) ) {
     /* The global setting is set to only parse the current file and the
     * file asked about is not the current one, thus do not parse it. */
     return false;
   }
 
-  if( ( settings->checkExternalFiles ) == false ) {
+  if( ( settings.checkExternalFiles ) == false ) {
     /* Do not check external files so check if the file is part of the
      * active project. */
     return d->filesInStartupProject.contains( fileName );
@@ -609,26 +1106,84 @@ void CppDocumentParser::futureFinished()
      * the list of watchers, thus no need to do anything more. */
     return;
   }
-  const CppDocumentProcessor::ResultType result = watcher->result();
+  /* The last result contains all the words of the file, previous results
+   * were partial chunks that were already emitted. */
+  const QFuture<CppDocumentProcessor::ResultType> future = watcher->future();
+  if( future.resultCount() == 0 ) {
+    return;
+  }
+  const CppDocumentProcessor::ResultType result = future.resultAt( future.resultCount() - 1 );
 
   const QString fileName = d->futureWatchers.remove( watcher );
-  if( fileName == d->currentEditorFileName ) {
+  /* Hashes created with settings that changed since are not kept, the file
+   * is already parsed again with the new settings. Hashes without the words
+   * before the settings were applied are not kept either, they can not be
+   * filtered again if only the filter settings change. */
+  if( ( fileName == d->currentEditorFileName )
+      && ( result.rawWordsKept == true )
+      && ( result.settingsGeneration == d->settingsSnapshot.generation() ) ) {
     /* Move the new list of hashes to the member data so that
      * it can be used the next time around. Move is made explicit since
      * the LHS can be removed and the RHS will not be used again from
      * here on. */
     d->tokenHashes = std::move( result.wordHashes );
+    d->sourceWords = result.sourceWords;
   }
-
-  {
-    QMutexLocker locker( &d->fileQeueMutex );
-    d->eraseIfFound( d->filesInProcess, fileName );
+  /* If the words of the file did not change since the previous time, there
+   * is no need to check them again. */
+  bool unchanged = false;
+  if( result.wordsFingerprint != 0 ) {
+    unchanged = ( d->wordsFingerprints.value( fileName ) == result.wordsFingerprint );
+    d->wordsFingerprints.insert( fileName, result.wordsFingerprint );
+  } else {
+    d->wordsFingerprints.remove( fileName );
   }
+  if( result.sourceWords.fingerprint != 0 ) {
+    /* The words in the source were collected, add them to the identifiers
+     * of the project. */
+    d->projectIdentifiers.update( fileName, result.sourceWords.words );
+  }
+
+  d->fileQueue.parsed( fileName );
   queueFilesForUpdate();
 
   /* Now that we have all of the words from the parser, emit the signal
    * so that they will get spell checked. */
-  emit spellcheckWordsParsed( fileName, result.words );
+  if( unchanged == true ) {
+    emit spellcheckWordsUnchanged( fileName, result.words, result.dictionaryGeneration );
+  } else {
+    emit spellcheckWordsParsed( fileName, result.words, result.dictionaryGeneration );
+  }
+}
+// --------------------------------------------------
+
+void CppDocumentParser::futureResultReady( int index )
+{
+  auto watcher = reinterpret_cast<CppDocumentProcessor::WatcherPtr>( sender() );
+  SP_CHECK( watcher != nullptr );
+  if( watcher->isCanceled() == true ) {
+    return;
+  }
+  const CppDocumentProcessor::ResultType result = watcher->resultAt( index );
+  if( result.partial == false ) {
+    /* The final result is handled when the future is finished. */
+    return;
+  }
+  const QString fileName = d->futureWatchers.fileName( watcher );
+  if( fileName.isEmpty() == true ) {
+    return;
+  }
+  emit spellcheckWordsChunkParsed( fileName, result.words, result.dictionaryGeneration );
+}
+// --------------------------------------------------
+
+void CppDocumentParser::wordsChecked( const QString& fileName, const WordList& words, const WordList& mistakes, quint64 generation )
+{
+  /* Only the hashes of the current file are kept. */
+  if( fileName != d->currentEditorFileName ) {
+    return;
+  }
+  d->tokenHashes.setVerdicts( words, mistakes, generation );
 }
 // --------------------------------------------------
 
@@ -645,17 +1200,29 @@ void CppDocumentParser::parseCppDocument( CPlusPlus::Document::Ptr docPtr )
   using ResultType = CppDocumentProcessor::ResultType;
   const QString fileName = docPtr->filePath().path();
   HashWords hashes;
+  SourceWords sourceWords;
+  IdentifierSetPtr projectIdentifiers;
+  VisibleRangePtr visibleRange;
+  /* This runs in the threads of the code model, the settings are only used
+   * through the snapshot. The processor keeps it for the whole job. */
+  const CppParserSettingsSnapshot settings = d->settingsSnapshot.load();
+  if( settings->value().removeWordsThatAppearInSource == true ) {
+    projectIdentifiers = d->projectIdentifiers.snapshot();
+  }
   if( fileName == d->currentEditorFileName ) {
-    hashes = d->tokenHashes.get();
+    hashes       = d->tokenHashes.get();
+    sourceWords  = d->sourceWords.get();
+    visibleRange = d->visibleRange;
   }
   /* Create a document parser and move it to the main thread.
    * Not sure if this is required but it seemed like a good
    * idea since this will be in a QThreadPool thread. */
-  CppDocumentProcessor* parser = new CppDocumentProcessor( docPtr, hashes, d->settings );
+  const quint64 generation     = SpellCheckerCore::instance()->dictionaryGeneration();
+  CppDocumentProcessor* parser = new CppDocumentProcessor( docPtr, hashes, sourceWords, projectIdentifiers, generation, settings, visibleRange );
   parser->moveToThread( qApp->thread() );
-  /* Reset the document pointer so that it can be released as soon as it is
-   * done in the processor. The processor makes its own copy to keep it
-   * alive. */
+  /* Reset the document pointer so that it can be released right away. The
+   * processor copied what it needs out of the document and only keeps the
+   * document if it must still visit its symbols. */
   docPtr.reset();
 
   /* Create a Future watcher that will be used to watch the future
@@ -665,25 +1232,22 @@ void CppDocumentParser::parseCppDocument( CPlusPlus::Document::Ptr docPtr )
    * processing does not work. */
   WatcherPtr watcher = new Watcher();
   watcher->moveToThread( qApp->thread() );
+  connect( watcher, &Watcher::resultReadyAt, this, &CppDocumentParser::futureResultReady, Qt::QueuedConnection );
   connect( watcher, &Watcher::finished, this,   &CppDocumentParser::futureFinished, Qt::QueuedConnection );
   connect( watcher, &Watcher::finished, parser, &CppDocumentProcessor::deleteLater );
   /* Keep track of the watchers so that they can be cancelled as needed. */
   d->futureWatchers.add( watcher, fileName );
-  /* Create a future to process the file.
+  /* Run the processor on the Parse stage of the pipeline.
    * If the file to process is the current open editor, it is parsed in a new
    * thread with high priority.
-   * If it is not the current file, it is added to the global thread pool
-   * since it can get processed in its own time.
+   * If it is not the current file, it is queued on the stage since it can get
+   * processed in its own time.
    * The current one gets a new thread so that it can get processed as
    * soon as possible and it does not need to get queued along with all other
-   * futures added to the global thread pool. */
-  if( fileName == d->currentEditorFileName ) {
-    QFuture<ResultType> future = Utils::asyncRun( QThread::HighPriority, &CppDocumentProcessor::process, parser );
-    watcher->setFuture( future );
-  } else {
-    QFuture<ResultType> future = Utils::asyncRun( QThreadPool::globalInstance(), QThread::NormalPriority, &CppDocumentProcessor::process, parser );
-    watcher->setFuture( future );
-  }
+   * files on the stage. */
+  const bool urgent          = ( fileName == d->currentEditorFileName );
+  QFuture<ResultType> future = SpellCheckerCore::instance()->pipeline()->stage( Pipeline::Parse )->run( urgent, &CppDocumentProcessor::process, parser );
+  watcher->setFuture( future );
 }
 // --------------------------------------------------
 
@@ -21,6 +21,7 @@
 #pragma once
 
 #include "../../idocumentparser.h"
+#include "../../spellcheckercoresettings.h"
 
 #include <cplusplus/CppDocument.h>
 #include <projectexplorer/projectexplorer.h>
@@ -52,6 +53,7 @@ protected:
   void setCurrentEditor( const QString& editorFilePath ) Q_DECL_OVERRIDE;
   void setActiveProject( ProjectExplorer::Project* activeProject ) Q_DECL_OVERRIDE;
   void updateProjectFiles( QStringSet filesAdded, QStringSet filesRemoved ) Q_DECL_OVERRIDE;
+  void setVisibleRange( const QString& editorFilePath, int32_t firstLine, int32_t lastLine ) Q_DECL_OVERRIDE;
 
 private:
   /*! \brief Queue files to be updated.
@@ -71,8 +73,22 @@ private:
 
 protected slots:
   void parseCppDocumentOnUpdate( CPlusPlus::Document::Ptr docPtr );
-  void settingsChanged();
+  /*! \brief Slot called when the settings changed.
+   *
+   * Only the cached state that is affected by the \a changes is dropped
+   * before the project is parsed again. */
+  void settingsChanged( SpellChecker::SettingsChanges changes );
   void futureFinished();
+  /*! \brief Slot called when the processor reported a result.
+   *
+   * Partial results are emitted as chunks of the file, the final result
+   * is handled by futureFinished(). */
+  void futureResultReady( int index );
+  /*! \brief Slot called when the core checked the words of a file.
+   *
+   * The verdicts are kept with the hashes of the tokens of the current file
+   * so that the words of tokens that do not change are not checked again. */
+  void wordsChecked( const QString& fileName, const SpellChecker::WordList& words, const SpellChecker::WordList& mistakes, quint64 generation );
   void aboutToQuit();
 
 public:
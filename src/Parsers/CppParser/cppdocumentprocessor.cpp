@@ -24,9 +24,17 @@
 
 #include <cplusplus/Overview.h>
 #include <cppeditor/cppdoxygen.h>
-#include <cppeditor/cppeditordocument.h>
-#include <cppeditor/cppmodelmanager.h>
-#include <cppeditor/editordocumenthandle.h>
+
+#include <QStringDecoder>
+#include <QtConcurrent>
+
+#include <cstring>
+#include <vector>
+
+// #define BENCH_TIME
+#ifdef BENCH_TIME
+#include <QElapsedTimer>
+#endif /* BENCH_TIME */
 
 using namespace SpellChecker;
 using namespace SpellChecker::CppSpellChecker::Internal;
@@ -36,99 +44,271 @@ using namespace SpellChecker::CppSpellChecker::Internal;
 // #define SP_CHECK( test ) QTC_CHECK( test )
 #define SP_CHECK( test )
 
+/*! \brief Number of tokens parsed before the words are reported as a partial result. */
+constexpr int32_t cTOKENS_PER_CHUNK = 256;
+/*! \brief Number of tokens from which the chunks of a file are parsed in parallel.
+ *
+ * Below this the overhead of the threads is more than the gain, and the
+ * files are parsed in parallel with each other anyway. */
+constexpr int32_t cPARALLEL_TOKEN_THRESHOLD = 8 * cTOKENS_PER_CHUNK;
+
+namespace {
+/*! \brief Range of tokens that make up a chunk. */
+struct ChunkRange
+{
+  int32_t begin;
+  int32_t end;
+};
+/*! \brief Result of parsing a chunk of tokens. */
+struct ChunkResult
+{
+  HashWords hashes;
+  WordList words;
+  quint64 fingerprint = 0; /*!< Sum of the fingerprints of the tokens of the chunk. */
+  bool checked        = true; /*!< If the mistakes of all tokens of the chunk were known. */
+};
+
+/*! \brief Multiply \a lhs and \a rhs to a 128 bit result, returned in \a lhs (low) and \a rhs (high). */
+inline void multiply128( quint64& lhs, quint64& rhs )
+{
+#if defined( __SIZEOF_INT128__ )
+  const unsigned __int128 product = static_cast<unsigned __int128>( lhs ) * rhs;
+  lhs = quint64( product );
+  rhs = quint64( product >> 64 );
+#else /* __SIZEOF_INT128__ */
+  const quint64 lhsHigh = lhs >> 32;
+  const quint64 lhsLow  = lhs & 0xFFFFFFFF;
+  const quint64 rhsHigh = rhs >> 32;
+  const quint64 rhsLow  = rhs & 0xFFFFFFFF;
+  const quint64 high    = lhsHigh * rhsHigh;
+  const quint64 middle0 = lhsHigh * rhsLow;
+  const quint64 middle1 = rhsHigh * lhsLow;
+  const quint64 low     = lhsLow * rhsLow;
+  const quint64 sum     = low + ( middle0 << 32 );
+  quint64 carry         = ( sum < low ) ? 1 : 0;
+  lhs                   = sum + ( middle1 << 32 );
+  carry                += ( lhs < sum ) ? 1 : 0;
+  rhs                   = high + ( middle0 >> 32 ) + ( middle1 >> 32 ) + carry;
+#endif /* __SIZEOF_INT128__ */
+}
+/*! \brief Multiply and fold the 128 bit result to 64 bits. */
+inline quint64 mix( quint64 lhs, quint64 rhs )
+{
+  multiply128( lhs, rhs );
+  return lhs ^ rhs;
+}
+inline quint64 read64( const uchar* bytes )
+{
+  quint64 value;
+  memcpy( &value, bytes, sizeof( value ) );
+  return value;
+}
+inline quint64 read32( const uchar* bytes )
+{
+  quint32 value;
+  memcpy( &value, bytes, sizeof( value ) );
+  return value;
+}
+
+/*! \brief 64 bit hash of the bytes of a token.
+ *
+ * This is the wyhash algorithm, a fast non cryptographic hash. The hash only
+ * needs to be stable within a run of the plugin, the byte order of the
+ * platform is not taken into account. */
+quint64 tokenHash( QByteArrayView bytes )
+{
+  static constexpr quint64 secret[4] = { 0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull };
+  const uchar* data = reinterpret_cast<const uchar*>( bytes.data() );
+  const size_t length = size_t( bytes.size() );
+  quint64 seed = mix( secret[0], secret[1] );
+  quint64 a;
+  quint64 b;
+  if( length <= 16 ) {
+    if( length >= 4 ) {
+      const size_t offset = ( length >> 3 ) << 2;
+      a = ( read32( data ) << 32 ) | read32( data + offset );
+      b = ( read32( data + length - 4 ) << 32 ) | read32( data + length - 4 - offset );
+    } else if( length > 0 ) {
+      a = ( quint64( data[0] ) << 16 ) | ( quint64( data[length >> 1] ) << 8 ) | data[length - 1];
+      b = 0;
+    } else {
+      a = 0;
+      b = 0;
+    }
+  } else {
+    size_t remaining = length;
+    if( remaining > 48 ) {
+      quint64 seed1 = seed;
+      quint64 seed2 = seed;
+      do {
+        seed       = mix( read64( data ) ^ secret[1], read64( data + 8 ) ^ seed );
+        seed1      = mix( read64( data + 16 ) ^ secret[2], read64( data + 24 ) ^ seed1 );
+        seed2      = mix( read64( data + 32 ) ^ secret[3], read64( data + 40 ) ^ seed2 );
+        data      += 48;
+        remaining -= 48;
+      } while( remaining > 48 );
+      seed ^= seed1 ^ seed2;
+    }
+    while( remaining > 16 ) {
+      seed       = mix( read64( data ) ^ secret[1], read64( data + 8 ) ^ seed );
+      data      += 16;
+      remaining -= 16;
+    }
+    a = read64( data + remaining - 16 );
+    b = read64( data + remaining - 8 );
+  }
+  a ^= secret[1];
+  b ^= seed;
+  multiply128( a, b );
+  return mix( a ^ secret[0] ^ length, b ^ secret[1] );
+}
+} // namespace
+
 class SpellChecker::CppSpellChecker::Internal::CppDocumentProcessorPrivate
 {
 public:
-  CPlusPlus::Document::Ptr docPtr;
+  CPlusPlus::Document::Ptr docPtr; /*!< Only kept if the symbols of the document must be visited. */
   HashWords tokenHashes;
-  CppParserSettings settings;
-  CPlusPlus::TranslationUnit* trUnit;
+  SourceWords sourceWords;
+  IdentifierSetPtr projectIdentifiers;
+  quint64 generation; /*!< Generation of the dictionary. */
+  CppParserSettingsSnapshot settingsSnapshot; /*!< Kept alive for the whole job. */
+  const CppParserSettings& settings;
+  QByteArray bytes;          /*!< Bytes of the tokens to parse, copied out of the document. */
+  QVector<TokenSpan> tokens; /*!< Tokens to parse, referring to the bytes. */
+  quint64 fingerprint = 0;   /*!< Fingerprint of the code, only if the words in the source are needed. */
+  QString source;            /*!< Bytes of the tokens decoded once when the processing starts. */
+  bool decodePerToken = false; /*!< The bytes are not valid UTF-8, each token is decoded on its own. */
   QString fileName;
+  FileId fileId;
+  bool keepRawWords; /*!< Keep the words before the settings are applied, only for the current file. */
+  VisibleRangePtr visibleRange;
 
-  CppDocumentProcessorPrivate( CPlusPlus::Document::Ptr documentPointer, const HashWords& hashWords, const CppParserSettings& cppSettings );
+  CppDocumentProcessorPrivate( CPlusPlus::Document::Ptr documentPointer, const HashWords& hashWords, const SourceWords& words, IdentifierSetPtr identifiers, quint64 dictionaryGeneration, CppParserSettingsSnapshot cppSettings, VisibleRangePtr range );
 };
 // --------------------------------------------------
 // --------------------------------------------------
 // --------------------------------------------------
 
-CppDocumentProcessorPrivate::CppDocumentProcessorPrivate( CPlusPlus::Document::Ptr documentPointer, const HashWords& hashWords, const CppParserSettings& cppSettings )
+CppDocumentProcessorPrivate::CppDocumentProcessorPrivate( CPlusPlus::Document::Ptr documentPointer, const HashWords& hashWords, const SourceWords& words, IdentifierSetPtr identifiers, quint64 dictionaryGeneration, CppParserSettingsSnapshot cppSettings, VisibleRangePtr range )
   : docPtr( documentPointer )
   , tokenHashes( hashWords )
-  , settings( cppSettings )
-  , trUnit( documentPointer->translationUnit() )
+  , sourceWords( words )
+  , projectIdentifiers( std::move( identifiers ) )
+  , generation( dictionaryGeneration )
+  , settingsSnapshot( std::move( cppSettings ) )
+  , settings( settingsSnapshot->value() )
   , fileName( documentPointer->filePath().path() )
+  , fileId( FileTable::id( fileName ) )
+  , keepRawWords( range != nullptr )
+  , visibleRange( std::move( range ) )
 {}
 // --------------------------------------------------
 
-CppDocumentProcessor::CppDocumentProcessor( CPlusPlus::Document::Ptr documentPointer, const HashWords& hashWords, const CppParserSettings& cppSettings )
+CppDocumentProcessor::CppDocumentProcessor( CPlusPlus::Document::Ptr documentPointer, const HashWords& hashWords, const SourceWords& sourceWords, IdentifierSetPtr projectIdentifiers, quint64 dictionaryGeneration, CppParserSettingsSnapshot cppSettings, VisibleRangePtr visibleRange )
   : QObject( nullptr )
-  , d( new CppDocumentProcessorPrivate( documentPointer, hashWords, cppSettings ) )
+  , d( new CppDocumentProcessorPrivate( documentPointer, hashWords, sourceWords, std::move( projectIdentifiers ), dictionaryGeneration, std::move( cppSettings ), std::move( visibleRange ) ) )
 {
-  d->docPtr->keepSourceAndAST();
+  /* Copy what must be parsed out of the document while its source and AST
+   * are still alive. A processor can wait a long time for a thread, keeping
+   * the source and AST of every waiting file alive used a lot of memory. */
+  snapshotTokens();
+  if( d->settings.removeWordsThatAppearInSource == true ) {
+    d->fingerprint = codeFingerprint( d->docPtr->translationUnit() );
+  }
+  /* The symbols of the document do not need the source or the AST, the
+   * document is only kept if they must be visited. */
+  if( ( d->settings.removeWordsThatAppearInSource == false )
+      || ( d->fingerprint == d->sourceWords.fingerprint ) ) {
+    d->docPtr.reset();
+  }
 }
 // --------------------------------------------------
 
 CppDocumentProcessor::~CppDocumentProcessor()
 {
-  if( d->docPtr != nullptr ) {
-    d->docPtr->releaseSourceAndAST();
-  }
+  delete d;
 }
 // --------------------------------------------------
 
-void CppDocumentProcessor::process( CppDocumentProcessor::Promise& promise )
+void CppDocumentProcessor::snapshotTokens()
 {
-  SP_CHECK( docPtr.isNull() == false );
+  const CPlusPlus::TranslationUnit* trUnit = d->docPtr->translationUnit();
+  const QByteArray utf8Source              = d->docPtr->utf8Source();
   SP_CHECK( trUnit != nullptr );
-  QStringSet wordsInSource;
-  QVector<WordTokens> wordTokens;
-  /* If the setting is set to remove words from the list based on words found in the source,
-   * parse the source file and then remove all words found in the source files from the list
-   * of words that will be checked. */
-  if( d->settings.removeWordsThatAppearInSource == true ) {
-    /* First get all words that does appear in the current source file. These words only
-     * include variables and their types */
-    wordsInSource = getWordsThatAppearInSource();
-  }
-
-  if( promise.isCanceled() == true ) {
-    promise.future().cancel();
-    return;
-  }
+  int32_t utf16Offset = 0;
+  const auto addToken = [this, trUnit, &utf8Source, &utf16Offset]( const CPlusPlus::Token& token, WordTokens::Type type ) {
+    if( ( qsizetype( token.bytesBegin() ) + token.bytes() ) > utf8Source.size() ) {
+      return;
+    }
+    /* Tokens do not start with white space, only the white space at the end
+     * is removed. White space is always one byte and one UTF-16 character. */
+    const char* tokenBytes = utf8Source.constData() + token.bytesBegin();
+    int32_t bytes          = int32_t( token.bytes() );
+    while( ( bytes > 0 )
+           && ( ( tokenBytes[bytes - 1] == ' ' )
+                || ( ( tokenBytes[bytes - 1] >= '\t' ) && ( tokenBytes[bytes - 1] <= '\r' ) ) ) ) {
+      --bytes;
+    }
+    const int32_t utf16Length = int32_t( token.utf16chars() ) - ( int32_t( token.bytes() ) - bytes );
+    int32_t line;
+    int32_t column;
+    trUnit->getPosition( token.utf16charsBegin(), &line, &column );
+    /* Check if the first comment should be be skipped.
+     * Doxygen comments are ignored since they normally are not used for headers
+     * and if they are they might contain more than just the license. */
+    if( ( type == WordTokens::Type::Comment )
+        && ( line == 1 )
+        && ( column == 1 )
+        && ( d->settings.removeFirstComment == true ) ) {
+      return;
+    }
+    d->tokens.append( { int32_t( d->bytes.size() ), bytes, utf16Offset, utf16Length, line, column, type } );
+    d->bytes.append( tokenBytes, bytes );
+    utf16Offset += utf16Length;
+  };
 
+  /* Most of the tokens that are parsed are comments, reserve for them up front. */
+  d->tokens.reserve( int32_t( trUnit->commentCount() ) );
   if( d->settings.whatToCheck.testFlag( CppParserSettings::CheckStringLiterals ) == true ) {
-    /* Parse string literals */
-    unsigned int tokenCount = d->trUnit->tokenCount();
+    /* Collect string literals */
+    QSet<quint64> expandedLiterals;
+    unsigned int tokenCount = trUnit->tokenCount();
     for( unsigned int idx = 0; idx < tokenCount; ++idx ) {
-      const CPlusPlus::Token& token = d->trUnit->tokenAt( idx );
+      const CPlusPlus::Token& token = trUnit->tokenAt( idx );
       if( token.isStringLiteral() == true ) {
         if( token.expanded() == true ) {
-          /* Expanded literals comes from macros. These are not checked since they can be the
-           * result of a macro like '__LINE__'. A user is not interested in such literals.
-           * The input arguments to Macros are more usable like MY_MAC("Some String").
-           * The macro arguments are checked after the normal literals are checked. */
-          continue;
+          if( token.generated() == true ) {
+            /* Generated literals comes from the definition of a macro, like '__LINE__' or a
+             * literal in the body of the macro. A user is not interested in such literals. */
+            continue;
+          }
+          /* The literal is an argument of a macro, like MY_MAC("Some String"). The translation
+           * unit knows the position of the argument in the source of the document, thus it is
+           * handled like any other literal, also for documents that are not open in an editor.
+           * An argument is expanded for every use of it in the macro, only the first
+           * expansion of each argument is parsed. */
+          int32_t line;
+          int32_t column;
+          trUnit->getPosition( token.utf16charsBegin(), &line, &column );
+          const quint64 position = ( quint64( uint32_t( line ) ) << 32 ) | uint32_t( column );
+          if( expandedLiterals.contains( position ) == true ) {
+            continue;
+          }
+          expandedLiterals.insert( position );
         }
 
-        /* The String Literal is not expanded thus handle it like a comment is handled. */
-        WordTokens tokens = parseToken( token, WordTokens::Type::Literal );
-        wordTokens.append( tokens );
+        /* Handle the String Literal like a comment is handled. */
+        addToken( token, WordTokens::Type::Literal );
       }
     }
-    /* Parse macros */
-    wordTokens += parseMacros();
-  }
-
-  if( promise.isCanceled() == true ) {
-    promise.future().cancel();
-    return;
   }
 
   if( d->settings.whatToCheck.testFlag( CppParserSettings::CheckComments ) == true ) {
-    /* Parse comments */
-    unsigned int commentCount = d->trUnit->commentCount();
+    /* Collect comments */
+    unsigned int commentCount = trUnit->commentCount();
     for( unsigned int comment = 0; comment < commentCount; ++comment ) {
-      const CPlusPlus::Token& token = d->trUnit->commentAt( comment );
+      const CPlusPlus::Token& token = trUnit->commentAt( comment );
       /* Check to see if the current comment type must be checked */
       if( ( d->settings.commentsToCheck.testFlag( CppParserSettings::CommentsC ) == false )
           && ( token.kind() == CPlusPlus::T_COMMENT ) ) {
@@ -146,9 +326,52 @@ void CppDocumentProcessor::process( CppDocumentProcessor::Promise& promise )
           || ( token.kind() == CPlusPlus::T_CPP_DOXY_COMMENT ) ) {
         type = WordTokens::Type::Doxygen;
       }
-      const WordTokens tokens = parseToken( token, type );
-      wordTokens.append( tokens );
+      addToken( token, type );
+    }
+  }
+}
+// --------------------------------------------------
+
+void CppDocumentProcessor::process( CppDocumentProcessor::Promise& promise )
+{
+#ifdef BENCH_TIME
+  QElapsedTimer timer;
+  timer.start();
+#endif /* BENCH_TIME */
+  /* Decode the bytes of the tokens once, the tokens and words refer to this
+   * buffer instead of each token being decoded on its own. Invalid UTF-8 is
+   * replaced while decoding, which moves the text of all the tokens after it
+   * away from their offsets. Then each token is decoded on its own. */
+  QStringDecoder decoder( QStringDecoder::Utf8 );
+  d->source = decoder.decode( d->bytes );
+  qsizetype utf16Size = 0;
+  for( const TokenSpan& span: qAsConst( d->tokens ) ) {
+    utf16Size += span.utf16Length;
+  }
+  d->decodePerToken = ( decoder.hasError() == true ) || ( d->source.size() != utf16Size );
+  if( d->decodePerToken == true ) {
+    d->source.clear();
+  }
+  QStringSet wordsInSource;
+  SourceWords sourceWordsOut;
+  QVector<TokenSpan>& tokensToParse = d->tokens;
+  /* If the setting is set to remove words from the list based on words found in the source,
+   * parse the source file and then remove all words found in the source files from the list
+   * of words that will be checked. */
+  if( d->settings.removeWordsThatAppearInSource == true ) {
+    /* First get all words that does appear in the current source file. These words only
+     * include variables and their types.
+     * If the code did not change since the previous time, for example if
+     * only comments were edited, the words from then are used. */
+    sourceWordsOut.fingerprint = d->fingerprint;
+    if( d->docPtr == nullptr ) {
+      sourceWordsOut.words = d->sourceWords.words;
+    } else {
+      sourceWordsOut.words = getWordsThatAppearInSource();
+      /* The symbols were the last thing that was needed of the document. */
+      d->docPtr.reset();
     }
+    wordsInSource = sourceWordsOut.words;
   }
 
   if( promise.isCanceled() == true ) {
@@ -156,11 +379,6 @@ void CppDocumentProcessor::process( CppDocumentProcessor::Promise& promise )
     return;
   }
 
-  /* At this point the DocPtr can be released since it will no longer be
-   * Used */
-  d->docPtr->releaseSourceAndAST();
-  d->docPtr.reset();
-
   // ----------------------------------
   /* Make a local copy of the last list of hashes. A local copy is made and used
    * as the input the tokenize function, but a new list is returned from the
@@ -173,31 +391,210 @@ void CppDocumentProcessor::process( CppDocumentProcessor::Promise& promise )
    * and this will mostly be the case when editing a file. For this reason the initial
    * project parse on start up can be slower. */
 
-  /* Populate the list of hashes from the tokens that was processed. */
+  /* Populate the list of hashes from the tokens that are processed. */
   HashWords newHashesOut;
   WordList  newSettingsApplied;
-  for( const WordTokens& token: qAsConst( wordTokens ) ) {
-    WordList words = token.words;
-    if( token.newHash == true ) {
-      /* The words are new, they were not known in a previous hash
-       * thus the settings must now be applied.
-       * Only words that have already been checked against the settings
-       * gets added to the hash, thus there is no need to apply the settings
-       * again, since this will only waste time. */
-      CppDocumentParser::applySettingsToWords( d->settings, token.string, wordsInSource, words );
+  quint64   wordsFingerprint = 0;
+  bool      allChecked       = true;
+
+  /* Parse the tokens in chunks. If there are more tokens than what fits in
+   * one chunk, the words of each chunk are reported as a partial result so that
+   * they can be checked while the rest of the file is still being parsed.
+   *
+   * Very large files, like generated headers, are parsed in waves of chunks
+   * where the chunks of a wave are parsed in parallel. The results of a wave are
+   * merged in the order of the chunks so that the result is the same as when
+   * the chunks are parsed one after the other.
+   *
+   * If the document is open in the current editor, the tokens that were not
+   * parsed yet are ordered by the visible lines before each wave if the user
+   * scrolled, so that the words that the user is looking at are reported
+   * first. */
+  const int32_t tokenCount    = int32_t( tokensToParse.size() );
+  const bool streamChunks     = ( tokenCount > cTOKENS_PER_CHUNK );
+  const int32_t chunksPerWave = ( tokenCount >= cPARALLEL_TOKEN_THRESHOLD )
+                                ? std::max( 1, QThread::idealThreadCount() )
+                                : 1;
+  const int32_t tokensPerWave = chunksPerWave * cTOKENS_PER_CHUNK;
+  const auto parseChunk       = [this, &tokensToParse, &wordsInSource]( const ChunkRange& chunk ) {
+    ChunkResult result;
+    for( int32_t idx = chunk.begin; idx < chunk.end; ++idx ) {
+      const quint64 tokenFingerprint = collectTokenWords( parseToken( tokensToParse.at( idx ) ), wordsInSource, result.hashes, result.words );
+      result.checked     = result.checked && ( tokenFingerprint != 0 );
+      result.fingerprint += tokenFingerprint;
+    }
+    return result;
+  };
+  quint64 orderedForRange = 0;
+  for( int32_t waveStart = 0; waveStart < tokenCount; waveStart += tokensPerWave ) {
+    if( ( streamChunks == true )
+        && ( d->visibleRange != nullptr )
+        && ( d->visibleRange->value() != orderedForRange ) ) {
+      orderedForRange = d->visibleRange->value();
+      orderByVisibleRange( tokensToParse.data() + waveStart, tokensToParse.data() + tokensToParse.size(), orderedForRange );
+    }
+    const int32_t waveEnd = std::min( waveStart + tokensPerWave, tokenCount );
+    std::vector<ChunkRange> chunks;
+    chunks.reserve( size_t( chunksPerWave ) );
+    for( int32_t chunkStart = waveStart; chunkStart < waveEnd; chunkStart += cTOKENS_PER_CHUNK ) {
+      chunks.push_back( { chunkStart, std::min( chunkStart + cTOKENS_PER_CHUNK, waveEnd ) } );
+    }
+    QVector<ChunkResult> results;
+    if( chunks.size() == 1 ) {
+      results.append( parseChunk( chunks.front() ) );
+    } else {
+      results = QtConcurrent::blockingMapped<QVector<ChunkResult>>( chunks.cbegin(), chunks.cend(), parseChunk );
+    }
+
+    if( promise.isCanceled() == true ) {
+      promise.future().cancel();
+      return;
+    }
+
+    for( ChunkResult& result: results ) {
+      for( HashWords::const_iterator iter = result.hashes.constBegin(); iter != result.hashes.constEnd(); ++iter ) {
+        newHashesOut.insert( iter.key(), iter.value() );
+      }
+      if( streamChunks == true ) {
+        ResultType chunk{ {}, result.words, true };
+        chunk.dictionaryGeneration = d->generation;
+        promise.addResult( chunk );
+      }
+      newSettingsApplied.append( result.words );
+      /* The fingerprints of the tokens are added so that the fingerprint of
+       * the file does not depend on the order that the tokens were parsed in. */
+      wordsFingerprint += result.fingerprint;
+      allChecked        = allChecked && result.checked;
     }
-    newSettingsApplied.append( words );
-    SP_CHECK( token.hash != 0x00 );
-    newHashesOut[token.hash] = { token.line, token.column, words };
   }
 
+#ifdef BENCH_TIME
+  qDebug() << "File: " << d->fileName
+           << "\n  - time  : " << timer.elapsed()
+           << "\n  - tokens: " << tokenCount
+           << "\n  - chunks per wave: " << chunksPerWave
+           << "\n  - tokens/s: " << ( qint64( tokenCount ) * 1000 ) / std::max<qint64>( 1, timer.elapsed() );
+#endif /* BENCH_TIME */
+
+  /* At this point the snapshot can be released since it will no longer be
+   * used */
+  d->tokens.clear();
+  d->bytes.clear();
+  d->source.clear();
+
   if( promise.isCanceled() == true ) {
     promise.future().cancel();
     return;
   }
 
   /* Done, report the words that should be spellchecked */
-  promise.addResult( ResultType{ std::move( newHashesOut ), std::move( newSettingsApplied ) } );
+  /* The fingerprint of the words is only useful if the mistakes of all the
+   * tokens are known, only then are the words that were reported the same as
+   * the previous time if the fingerprint matches. The dictionary is part of the
+   * verdicts and the settings decide which words are reported, both are thus
+   * part of the fingerprint. */
+  const quint64 settingsGeneration = d->settingsSnapshot->generation();
+  if( allChecked == true ) {
+    wordsFingerprint = mix( wordsFingerprint ^ d->generation, 0x9e3779b97f4a7c15ull );
+    wordsFingerprint = mix( wordsFingerprint ^ settingsGeneration, 0x9e3779b97f4a7c15ull );
+    wordsFingerprint = ( wordsFingerprint != 0 ) ? wordsFingerprint : 1;
+  } else {
+    wordsFingerprint = 0;
+  }
+  promise.addResult( ResultType{ std::move( newHashesOut ), std::move( newSettingsApplied ), false, std::move( sourceWordsOut ), wordsFingerprint, settingsGeneration, d->keepRawWords, d->generation } );
+}
+// --------------------------------------------------
+
+quint64 CppDocumentProcessor::collectTokenWords( const WordTokens& tokens, const QStringSet& wordsInSource, HashWords& hashesOut, WordList& wordsOut ) const
+{
+  if( tokens.hash == 0x00 ) {
+    /* The token was rejected by parseToken(), it has no words and must not
+     * be added to the hashes. */
+    return 1;
+  }
+  WordList words = tokens.words;
+  WordList rawWords;
+  if( tokens.newHash == true ) {
+    /* The words are new, they were not known in a previous hash
+     * thus the settings must now be applied.
+     * Only words that have already been checked against the settings
+     * gets added to the hash, thus there is no need to apply the settings
+     * again, since this will only waste time. */
+    if( d->keepRawWords == true ) {
+      /* The words before the settings are applied are kept for the current
+       * file so that a change to the filter settings does not have to
+       * extract the words from the tokens again. */
+      rawWords = ( tokens.rawWords.isEmpty() == false ) ? tokens.rawWords : words;
+    }
+    CppDocumentParser::applySettingsToWords( d->settings, tokens.string, wordsInSource, words );
+    /* The text of extracted words refers to the string of the token, only
+     * the words that are kept get their own copy of the text. */
+    const QChar* sourceBegin = tokens.string.constData();
+    const QChar* sourceEnd   = sourceBegin + tokens.string.size();
+    const auto detachText    = [sourceBegin, sourceEnd]( WordList& wordsToDetach ) {
+      for( Word& word: wordsToDetach ) {
+        const QChar* text = word.text.constData();
+        if( ( text >= sourceBegin ) && ( text < sourceEnd ) ) {
+          word.text = QString( text, word.text.size() );
+        }
+      }
+    };
+    detachText( words );
+    detachText( rawWords );
+  } else if( d->keepRawWords == true ) {
+    rawWords = tokens.rawWords;
+  }
+  hashesOut[tokens.hash] = { tokens.line, tokens.column, words, tokens.length, tokens.mistakes, tokens.generation, rawWords };
+  if( tokens.generation != 0 ) {
+    /* The words of the token were checked with the current dictionary, only
+     * the mistakes are passed on and they do not have to be checked again. */
+    words = tokens.mistakes;
+    for( Word& word: words ) {
+      word.checked = true;
+    }
+  }
+  /* The identifiers of the project are applied after the words were added
+   * to the hashes. The identifiers change as other files are parsed, the words
+   * of unchanged tokens must be checked against the latest identifiers. */
+  if( ( d->projectIdentifiers != nullptr )
+      && ( d->settings.removeWordsThatAppearInSource == true ) ) {
+    IDocumentParser::removeWordsThatAppearInSource( *d->projectIdentifiers, words );
+  }
+  wordsOut.append( words );
+  if( tokens.generation == 0 ) {
+    return 0;
+  }
+  /* Fingerprint of the token and the words that it passed on. The position of
+   * the token is not part of it, a token that only moved does not change it. */
+  quint64 fingerprint = mix( tokens.hash, quint64( tokens.length ) );
+  for( const Word& word: words ) {
+    fingerprint = mix( fingerprint ^ qHash( word.text ), 0x9e3779b97f4a7c15ull );
+  }
+  return ( fingerprint != 0 ) ? fingerprint : 1;
+}
+// --------------------------------------------------
+
+void CppDocumentProcessor::orderByVisibleRange( TokenSpan* begin, TokenSpan* end, quint64 range )
+{
+  if( range == 0 ) {
+    return;
+  }
+  /* Add a page above and below the visible lines as margin. */
+  const int32_t page      = VisibleRange::lastLine( range ) - VisibleRange::firstLine( range ) + 1;
+  const int32_t firstLine = VisibleRange::firstLine( range ) - page;
+  const int32_t lastLine  = VisibleRange::lastLine( range ) + page;
+  const auto distance     = [firstLine, lastLine]( const TokenSpan& token ) {
+    if( token.line < firstLine ) {
+      return firstLine - token.line;
+    }
+    if( token.line > lastLine ) {
+      return token.line - lastLine;
+    }
+    return 0;
+  };
+  std::stable_sort( begin, end, [&distance]( const TokenSpan& lhs, const TokenSpan& rhs ) {
+    return distance( lhs ) < distance( rhs );
+  } );
 }
 // --------------------------------------------------
 
@@ -209,23 +606,21 @@ QStringSet CppDocumentProcessor::getWordsThatAppearInSource() const
   CPlusPlus::Overview overview;
   for( uint32_t i = 0; i < total; ++i ) {
     CPlusPlus::Symbol* symbol = d->docPtr->globalSymbolAt( i );
-    wordsSet += getListOfWordsFromSourceRecursive( symbol, overview );
+    addWordsFromSourceRecursive( symbol, overview, wordsSet );
   }
   return wordsSet;
 }
 // --------------------------------------------------
 
-QStringSet CppDocumentProcessor::getListOfWordsFromSourceRecursive( const CPlusPlus::Symbol* symbol, const CPlusPlus::Overview& overview ) const
+void CppDocumentProcessor::addWordsFromSourceRecursive( const CPlusPlus::Symbol* symbol, const CPlusPlus::Overview& overview, QStringSet& wordsInSource ) const
 {
-  QStringSet wordsInSource;
   /* Get the pretty name and type for the current symbol. This name is then split up into
    * different words that are added to the list of words that appear in the source */
-  const QString name = overview.prettyName( symbol->name() ).trimmed();
-  const QString type = overview.prettyType( symbol->type() ).trimmed();
-  wordsInSource += getPossibleNamesFromString( name );
-  wordsInSource += getPossibleNamesFromString( type );
+  addPossibleNamesFromString( overview.prettyName( symbol->name() ), wordsInSource );
+  addPossibleNamesFromString( overview.prettyType( symbol->type() ), wordsInSource );
 
-  /* Go to the next level into the scope of the symbol and get the words from that level as well*/
+  /* Go to the next level into the scope of the symbol and get the words from that level as well.
+   * All levels add to the same set instead of merging a set per level. */
   const CPlusPlus::Scope* scope = symbol->asScope();
   if( scope != nullptr ) {
     CPlusPlus::Scope::iterator cur = scope->memberBegin();
@@ -235,80 +630,105 @@ QStringSet CppDocumentProcessor::getListOfWordsFromSourceRecursive( const CPlusP
       if( !curSymbol ) {
         continue;
       }
-      wordsInSource += getListOfWordsFromSourceRecursive( curSymbol, overview );
+      addWordsFromSourceRecursive( curSymbol, overview, wordsInSource );
     }
   }
-  return wordsInSource;
 }
 // --------------------------------------------------
 
-QStringSet CppDocumentProcessor::getPossibleNamesFromString( const QString& string ) const
+void CppDocumentProcessor::addPossibleNamesFromString( const QString& string, QStringSet& wordSet )
 {
-  QStringSet wordSet;
-  static const QRegularExpression nameRegExp( QStringLiteral( "(\\w+)" ) );
-  QRegularExpressionMatchIterator i = nameRegExp.globalMatch( string );
-  while( i.hasNext() ) {
-    const QRegularExpressionMatch match = i.next();
-    wordSet += match.captured( 1 );
-  }
-  return wordSet;
+  /* Split the string on all characters that can not be part of an identifier. */
+  const int32_t length = int32_t( string.length() );
+  int32_t wordStart    = -1;
+  for( int32_t pos = 0; pos <= length; ++pos ) {
+    const bool identifierChar = ( pos < length )
+                                && ( ( string.at( pos ).isLetterOrNumber() == true )
+                                     || ( string.at( pos ) == QLatin1Char( '_' ) ) );
+    if( identifierChar == true ) {
+      if( wordStart < 0 ) {
+        wordStart = pos;
+      }
+    } else if( wordStart >= 0 ) {
+      wordSet.insert( string.mid( wordStart, pos - wordStart ) );
+      wordStart = -1;
+    }
+  }
 }
 // --------------------------------------------------
 
-WordTokens CppDocumentProcessor::parseToken( const CPlusPlus::Token& token, WordTokens::Type type ) const
+quint64 CppDocumentProcessor::codeFingerprint( const CPlusPlus::TranslationUnit* trUnit )
 {
-  int32_t line;
-  int32_t col;
-  /* Get the index of the token. The index is used to get the position of the token.
-   * Doing this first so that the token can be ignored if it is the first comment */
-  const int32_t tokenBegin = token.utf16charsBegin();
-  d->trUnit->getPosition( tokenBegin, &line, &col );
-  /* Check if the first comment should be be returned.
-   * This will be checked for every token, including literals and doxygen
-   * comments. The check relies on early return of the if, thus the options
-   * that are most likely to result in the check failing is first.
-   * Doxygen comments are ignored since they normally are not used for headers
-   * and if they are they might contain more than just the license. */
-  if( ( type == WordTokens::Type::Comment )
-      && ( line == 1 )
-      && ( col == 1 )
-      && ( d->settings.removeFirstComment == true ) ) {
+  quint64 fingerprint  = 0;
+  const uint32_t count = trUnit->tokenCount();
+  for( uint32_t idx = 0; idx < count; ++idx ) {
+    const CPlusPlus::Token& token = trUnit->tokenAt( idx );
+    quint64 value = token.kind();
+    if( ( token.isIdentifier() == true )
+        && ( token.identifier != nullptr ) ) {
+      value ^= tokenHash( QByteArrayView( token.identifier->chars(), token.identifier->size() ) );
+    }
+    fingerprint = mix( fingerprint ^ value, 0x9e3779b97f4a7c15ull );
+  }
+  /* Never return 0, it is used for words that were not collected. */
+  return ( fingerprint != 0 ) ? fingerprint : 1;
+}
+// --------------------------------------------------
+
+WordTokens CppDocumentProcessor::parseToken( const TokenSpan& span ) const
+{
+  const QByteArrayView tokenBytes = QByteArrayView( d->bytes ).sliced( span.bytesBegin, span.bytes );
+  /* The token string refers to the decoded bytes, unless they were not valid
+   * UTF-8. */
+  QString tokenString;
+  if( d->decodePerToken == false ) {
+    tokenString = QString::fromRawData( d->source.constData() + span.utf16Begin, span.utf16Length );
+  } else {
+    tokenString = QString::fromUtf8( tokenBytes );
+  }
+  if( tokenString.size() != span.utf16Length ) {
+    /* The token does not decode to the characters that the lexer counted,
+     * the positions of its words would be wrong. The token is rejected with
+     * a hash of 0. */
     return {};
   }
-  /* Get the token string */
-  const QString tokenString = QString::fromUtf8( d->docPtr->utf8Source().mid( token.bytesBegin(), token.bytes() ).trimmed() );
-  /* Calculate the hash of the token string */
-  const uint32_t hash = qHash( tokenString );
 
-  /* Set up the known parts of the return structure.
+  /* Calculate the hash from the bytes of the token, there is no need to
+   * decode the token to hash it.
+   * Set up the known parts of the return structure.
    * The rest will be populated as needed below. */
   WordTokens tokens;
-  tokens.hash   = hash;
-  tokens.column = col;
-  tokens.line   = line;
+  tokens.hash   = tokenHash( tokenBytes );
+  tokens.length = int32_t( tokenBytes.size() );
+  tokens.column = span.column;
+  tokens.line   = span.line;
   tokens.string = tokenString;
-  tokens.type   = type;
+  tokens.type   = span.type;
 
-  TmpOptional wordOpt = checkHash( tokens, hash );
+  TmpOptional wordOpt = checkHash( tokens );
   if( wordOpt.first == true ) {
     return wordOpt.second;
   }
 
   /* Token was not in the list of hashes.
    * Tokenize the string to extract words that should be checked. */
-  tokens.words   = extractWordsFromString( tokenString, tokenBegin, type );
+  tokens.words   = extractWordsFromString( tokenString, span.line, span.column, span.type );
   tokens.newHash = true;
   return tokens;
 }
 // --------------------------------------------------
 
-WordList CppDocumentProcessor::extractWordsFromString( const QString& string, int32_t stringStart, WordTokens::Type type ) const
+WordList CppDocumentProcessor::extractWordsFromString( const QString& string, int32_t line, int32_t column, WordTokens::Type type ) const
 {
   WordList wordTokens;
   const int32_t strLength = string.length();
   bool busyWithWord       = false;
   int32_t wordStartPos    = 0;
   bool endOfWord          = false;
+  /* The line and column of the words are tracked while scanning. The column
+   * of a character is its position minus the position of the start of its
+   * line, for the first line that start lies before the string. */
+  int32_t lineStart = -column;
 
   /* Iterate through all of the characters in the comment and extract words from them.
    * Words are split up by non-word characters and is checked using the isEndOfCurrentWord()
@@ -334,10 +754,11 @@ WordList CppDocumentProcessor::extractWordsFromString( const QString& string, in
        */
       SP_CHECK( wordStartPos > 0 );
       Word word;
-      word.fileName  = d->fileName;
-      word.text      = string.mid( wordStartPos, currentPos - wordStartPos );
+      word.fileId    = d->fileId;
+      /* The text refers to the data of the string, it is copied once the
+       * word survived the settings. */
+      word.text      = QString::fromRawData( string.constData() + wordStartPos, currentPos - wordStartPos );
       word.start     = wordStartPos;
-      word.end       = currentPos;
       word.length    = currentPos - wordStartPos;
       word.charAfter = ( currentPos < strLength )
                        ? string.at( currentPos )
@@ -359,12 +780,20 @@ WordList CppDocumentProcessor::extractWordsFromString( const QString& string, in
         }
       }
       if( isDoxygenTag == false ) {
-        d->trUnit->getPosition( stringStart + uint32_t( wordStartPos ), &word.lineNumber, &word.columnNumber );
+        word.lineNumber   = line;
+        word.columnNumber = wordStartPos - lineStart;
         wordTokens.append( std::move( word ) );
       }
       busyWithWord = false;
       wordStartPos = 0;
     }
+    /* A new line always ends a word, move to the next line only after the
+     * word that ended on it was added. */
+    if( ( currentPos < strLength )
+        && ( string.at( currentPos ) == QLatin1Char( '\n' ) ) ) {
+      ++line;
+      lineStart = currentPos;
+    }
   }
   return wordTokens;
 }
@@ -448,156 +877,19 @@ bool CppDocumentProcessor::isEndOfCurrentWord( const QString& comment, int curre
 }
 // --------------------------------------------------
 
-QVector<WordTokens> CppDocumentProcessor::parseMacros() const
-{
-  /* Get the macros from the document pointer. The arguments of the macro will then be parsed
-   * and checked for spelling mistakes.
-   * Since the TranslationUnit::getPosition() is not usable with the Macro Uses a manual method to
-   * extract the literals and their line and column positions are implemented. This involves getting
-   * the unprocessed source from the document for the macro and tracking the byte offsets manually
-   * from there. An alternative implementation can involve using the
-   * Snapshot::preprocessedDocument(), which makes use of the FastPreprocessor and the AST visitors.
-   * For more information around a discussion on the mailing list around this issue refer to the
-   * following
-   * link: http://comments.gmane.org/gmane.comp.lib.qt.creator/11853 */
-  QVector<WordTokens> tokenizedWords;
-  QList<CPlusPlus::Document::MacroUse> macroUse = d->docPtr->macroUses();
-  if( macroUse.count() == 0 ) {
-    return {};
-  }
-  static CppEditor::CppModelManager* cppModelManager    = CppEditor::CppModelManager::instance();
-  CppEditor::CppEditorDocumentHandle* cppEditorDocument = cppModelManager->cppEditorDocument( d->docPtr->filePath() );
-  if( cppEditorDocument == nullptr ) {
-    return {};
-  }
-  const QByteArray source = cppEditorDocument->contents();
-
-  for( const CPlusPlus::Document::MacroUse& mac: macroUse ) {
-    if( mac.isFunctionLike() == false ) {
-      /* Only macros that are function like should be considered.
-       * These are ones that have arguments, that can be literals.
-       */
-      continue;
-    }
-    const QVector<CPlusPlus::Document::Block>& args = mac.arguments();
-    if( args.count() == 0 ) {
-      /* There are no arguments for the macro, no need to consider
-       * further. */
-      continue;
-    }
-    /* The line number of the macro is used as the reference. */
-    uint32_t line = mac.beginLine();
-    /* Get the start of the line from the source. From this start the offset to the
-     * words will be calculated. This start should never be -1 since
-     * a line will always start with a newline, and it seems like a macro
-     * will never start on the first line of the source file.
-     * Added a debug assert just to ensure this. */
-    const uint32_t start = uint32_t( source.lastIndexOf( '\n', int32_t( mac.utf16charsBegin() ) ) );
-    SP_CHECK( source.lastIndexOf( '\n', int32_t( mac.utf16charsBegin() ) ) > 0 );
-    /* Get the end index of the last argument of the macro. */
-    const uint32_t end = args.last().utf16charsEnd();
-    SP_CHECK( start < end );
-    if( end == 0 ) {
-      /* This will happen on an empty argument, for example Q_ASSERT() */
-      continue;
-    }
-
-    /* Get the full macro from the start of the line until the last byte of the last
-     * argument. */
-    const QByteArray macroBytes = source.mid( int32_t( start ), int32_t( end - start ) );
-    /* Quick check to see if there are any string literals in the macro text.
-     * if the are this check can be a waist, but if not this can speed up the check by
-     * avoiding an unneeded regular expression. */
-    if( macroBytes.contains( '\"' ) == false ) {
-      continue;
-    }
-
-    /* Check if the hash of the macro is not already contained
-     * in the list of known hashes. The hash is calculated from the
-     * start of the macro and not the line so that the movement of the
-     * macro due to edits before the macro can be handled using the hash
-     * functionality.*/
-    WordTokens tokens;
-    tokens.column  = mac.utf16charsBegin() - start;
-    tokens.line    = line;
-    tokens.string  = QString::fromUtf8( macroBytes.mid( int32_t( mac.utf16charsBegin() - start ) ) );
-    tokens.hash    = qHash( tokens.string );
-    tokens.type    = WordTokens::Type::Literal;
-    tokens.newHash = true;
-
-    TmpOptional wordOpt = checkHash( tokens, tokens.hash );
-    if( wordOpt.first == true ) {
-      tokenizedWords.append( wordOpt.second );
-      continue;
-    }
-
-    /* Get the byte offsets inside the macro bytes for each line break inside the macro.
-     * This will be used during the extraction to get the correct lines relative to the
-     * line that the macro started on. */
-    QVector<uint32_t> lineIndexes;
-    /* The search above for the start include the new line character so the start for other
-     * new lines must start from index 1 so that it is not also included. */
-    int32_t startSearch = 1;
-    while( true ) {
-      int idx = macroBytes.indexOf( '\n', startSearch );
-      if( idx < 0 ) {
-        /* No more new lines, break out */
-        break;
-      }
-      lineIndexes << uint32_t( idx );
-      /* Must increment the start of the next search otherwise it will be found on
-       * that index. */
-      startSearch = idx + 1;
-    }
-    /* The end is also added to simplify some of the checks further on. No character can
-     * fall outside of the end. */
-    lineIndexes << uint32_t( end );
-    uint32_t lineBreak = lineIndexes.takeFirst();
-    uint32_t colOffset = 0;
-
-    /* Use a regular expression to get all string literals from the macro and its arguments. */
-    static const QRegularExpression regExp( QStringLiteral( "\"([^\"\\\\]|\\\\.)*\"" ) );
-    QRegularExpressionMatchIterator regExpIter = regExp.globalMatch( QString::fromLatin1( macroBytes ) );
-    while( regExpIter.hasNext() == true ) {
-      const QRegularExpressionMatch match = regExpIter.next();
-      const QString tokenString           = match.captured( 0 );
-      SP_CHECK( match.capturedStart( 0 ) >= 0 );
-      const uint32_t capStart = uint32_t( match.capturedStart( 0 ) );
-      /* Check if the literal starts on the next line from the current one */
-      while( capStart > lineBreak ) {
-        /* Increase the line number and reset the column offset */
-        ++line;
-        colOffset = lineBreak;
-        lineBreak = lineIndexes.takeFirst();
-      }
-      /* Get the words from the extracted literal */
-      WordList words = extractWordsFromString( tokenString, 0, WordTokens::Type::Literal );
-      for( Word& word: words ) {
-        /* Apply the offsets to the words */
-        word.columnNumber += capStart - colOffset;
-        word.lineNumber    = line;
-      }
-      tokens.words.append( words );
-      /* Get the words from the extracted literal */
-    }
-    if( tokens.words.count() != 0 ) {
-      tokenizedWords.append( tokens );
-    }
-  }
-  return tokenizedWords;
-}
-// --------------------------------------------------
-
-CppDocumentProcessor::TmpOptional CppDocumentProcessor::checkHash( WordTokens tokens, uint32_t hash ) const
+CppDocumentProcessor::TmpOptional CppDocumentProcessor::checkHash( WordTokens tokens ) const
 {
   /* Search if the hash contains the given token. If it does
    * then the words that got extracted previously are used
    * as is, without attempting to extract them again. If the
    * token is not in the hash, it is a new token and must be
    * parsed to get the words from the token. */
-  HashWords::const_iterator iter          = d->tokenHashes.constFind( hash );
+  HashWords::const_iterator iter          = d->tokenHashes.constFind( tokens.hash );
   const HashWords::const_iterator iterEnd = d->tokenHashes.constEnd();
-  if( iter != iterEnd ) {
+  /* The length of the token is compared as well, a different length means
+   * that another token had the same hash. */
+  if( ( iter != iterEnd )
+      && ( iter.value().length == tokens.length ) ) {
     /* The token was parsed in a previous iteration.
      * Now check if the token moved due to lines being
      * added or removed. It it did not move, use the
@@ -605,13 +897,33 @@ CppDocumentProcessor::TmpOptional CppDocumentProcessor::checkHash( WordTokens to
      * column number of the words by the amount that the
      * token moved. */
     const TokenWords& tokenWords = ( iter.value() );
+    /* The mistakes among the words are only known if they were checked with
+     * the current dictionary. */
+    const bool verdictKnown = ( tokenWords.generation != 0 )
+                              && ( tokenWords.generation == d->generation );
+    tokens.newHash = false;
+    /* If the filter settings changed since the words were kept, the words
+     * extracted from the token are still valid but the settings must be
+     * applied to them again. */
+    const auto refilter = []( const TokenWords& tokenWords, WordTokens& found ) -> WordTokens& {
+      if( tokenWords.filtered == false ) {
+        found.words      = found.rawWords;
+        found.newHash    = true;
+        found.mistakes   = WordList();
+        found.generation = 0;
+      }
+      return found;
+    };
     if( ( tokenWords.line == tokens.line )
         && ( tokenWords.col == tokens.column ) ) {
-      tokens.words   = tokenWords.words;
-      tokens.newHash = false;
-      return std::make_pair( true, tokens );
+      tokens.words    = tokenWords.words;
+      tokens.rawWords = tokenWords.rawWords;
+      if( verdictKnown == true ) {
+        tokens.mistakes   = tokenWords.mistakes;
+        tokens.generation = tokenWords.generation;
+      }
+      return std::make_pair( true, refilter( tokenWords, tokens ) );
     } else {
-      WordList words;
       /* Token moved, adjust.
        * This will even work for lines that are copied because the
        * hash will be the same but the start will just be different. */
@@ -626,16 +938,25 @@ CppDocumentProcessor::TmpOptional CppDocumentProcessor::checkHash( WordTokens to
        * would be new and it would be regarded as a new hash. A move
        * on the column will not cause this, but will also not move the
        * words below it, thus they should not be updated. */
-      for( Word word: qAsConst( tokenWords.words ) ) {
-        word.lineNumber = uint32_t( int32_t( word.lineNumber ) - lineDiff );
-        if( word.lineNumber == firstLine ) {
-          word.columnNumber = uint32_t( int32_t( word.columnNumber ) - colDiff );
+      const auto moveWords = [lineDiff, colDiff, firstLine]( const WordList& wordsToMove ) {
+        WordList words;
+        words.reserve( wordsToMove.size() );
+        for( Word word: wordsToMove ) {
+          word.lineNumber = uint32_t( int32_t( word.lineNumber ) - lineDiff );
+          if( word.lineNumber == firstLine ) {
+            word.columnNumber = uint32_t( int32_t( word.columnNumber ) - colDiff );
+          }
+          words.append( word );
         }
-        words.append( word );
+        return words;
+      };
+      tokens.words    = moveWords( tokenWords.words );
+      tokens.rawWords = moveWords( tokenWords.rawWords );
+      if( verdictKnown == true ) {
+        tokens.mistakes   = moveWords( tokenWords.mistakes );
+        tokens.generation = tokenWords.generation;
       }
-      tokens.words   = words;
-      tokens.newHash = false;
-      return std::make_pair( true, tokens );
+      return std::make_pair( true, refilter( tokenWords, tokens ) );
     }
   }
   return std::make_pair( false, WordTokens{} );
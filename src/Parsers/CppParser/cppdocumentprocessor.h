@@ -27,6 +27,9 @@
 
 #include <QFuture>
 
+#include <atomic>
+#include <memory>
+
 namespace CPlusPlus {
 class Overview;
 } // namespace CPlusPlus
@@ -50,7 +53,10 @@ namespace Internal {
  *
  * The \a newHash flag keeps track if the words were extracted in a
  * previous pass or not, meaning that they were already processed and does not
- * need to be processed further. */
+ * need to be processed further.
+ *
+ * If the words of the token were spell checked with the current dictionary,
+ * the \a mistakes among them are known and \a generation is set. */
 struct WordTokens
 {
   enum class Type {
@@ -60,14 +66,92 @@ struct WordTokens
   };
 
   HashWords::key_type hash;
+  int32_t length = 0; /*!< Number of bytes of the token, stored with the hash to detect collisions. */
   int32_t line   = 0;
   int32_t column = 0;
   QString string;
   WordList words;
   bool newHash = true;
   Type type;
+  WordList mistakes;      /*!< Mistakes among the words, only valid if \a generation is set. */
+  quint64 generation = 0; /*!< Generation of the dictionary of the \a mistakes, 0 if not known. */
+  WordList rawWords;      /*!< Words before the settings were applied, only kept for the current file. */
+};
+
+/*! \brief Words that appear in the source of a document.
+ *
+ * The words are collected from the names and types of the symbols of the
+ * document. The fingerprint of the code that the words were collected from is
+ * kept with them so that the walk over the symbols can be skipped when only
+ * the comments of the document changed. */
+struct SourceWords
+{
+  quint64 fingerprint = 0; /*!< Fingerprint of the code, 0 if the words were not collected. */
+  QStringSet words;        /*!< Words that appear in the source. */
 };
 
+/*! \brief A token copied out of the translation unit that must be parsed.
+ *
+ * The comments and literals that must be parsed are copied out of the
+ * document when the processor is constructed so that the source and AST of
+ * the document do not have to be kept alive while the processor waits for a
+ * thread. The bytes of the tokens are stored one after the other, the span
+ * refers to its bytes and to its text once those bytes are decoded. */
+struct TokenSpan
+{
+  int32_t bytesBegin;    /*!< Offset of the token in the bytes of the snapshot. */
+  int32_t bytes;         /*!< Number of bytes of the token, without white space at the end. */
+  int32_t utf16Begin;    /*!< Offset of the token in the decoded text of the snapshot. */
+  int32_t utf16Length;   /*!< Number of UTF-16 characters of the token. */
+  int32_t line;          /*!< Line of the token in the document. */
+  int32_t column;        /*!< Column of the token in the document. */
+  WordTokens::Type type; /*!< Type of the token passed to parseToken(). */
+};
+
+/*! \brief The Visible Range of the current editor.
+ *
+ * The range is shared between the parser and the processor of the current
+ * file. The parser updates it as the user scrolls and the processor reads it
+ * between chunks to parse the visible lines first.
+ *
+ * The first and last line are stored in one atomic value so that a reader
+ * always gets a consistent range. A value of 0 means that the range is not
+ * known. */
+class VisibleRange
+{
+public:
+  /*! \brief Set the visible lines. */
+  void set( int32_t firstLine, int32_t lastLine )
+  {
+    d_range = ( quint64( uint32_t( firstLine ) ) << 32 ) | uint32_t( lastLine );
+  }
+  /*! \brief Clear the range, for example when the editor changes. */
+  void clear()
+  {
+    d_range = 0;
+  }
+  /*! \brief Get the current packed range. */
+  quint64 value() const
+  {
+    return d_range;
+  }
+  /*! \brief First line from a packed range. */
+  static int32_t firstLine( quint64 range )
+  {
+    return int32_t( range >> 32 );
+  }
+  /*! \brief Last line from a packed range. */
+  static int32_t lastLine( quint64 range )
+  {
+    return int32_t( range & 0xFFFFFFFF );
+  }
+private:
+  std::atomic<quint64> d_range{ 0 };
+};
+using VisibleRangePtr = std::shared_ptr<const VisibleRange>;
+/*! \brief Read only snapshot of the identifiers that appear in the project. */
+using IdentifierSetPtr = std::shared_ptr<const QStringSet>;
+
 class CppDocumentProcessorPrivate;
 /*! \brief The C++ Document Processor class.
  *
@@ -93,6 +177,21 @@ public:
   {
     HashWords wordHashes; /*!< List of hashes extracted along with words from the hash. */
     WordList words;       /*!< Word tokens that were extracted by the processor. */
+    bool partial = false; /*!< If the result is a chunk of the words of a large file. The
+                           * last result of the future is never partial and contains
+                           * all the words and hashes. */
+    SourceWords sourceWords; /*!< Words that appear in the source of the document, only
+                              * set on the last result. */
+    quint64 wordsFingerprint = 0; /*!< Fingerprint of the words of the tokens, without their
+                                   * positions, only set on the last result and only if the
+                                   * mistakes of all tokens were known. If it matches the
+                                   * previous result of the file, the words only moved. */
+    quint64 settingsGeneration = 0; /*!< Generation of the settings that the words were
+                                     * extracted with. */
+    bool rawWordsKept = false; /*!< If the hashes keep the words of the tokens before the
+                                * settings were applied, only set on the last result. */
+    quint64 dictionaryGeneration = 0; /*!< Generation of the dictionary that the words
+                                       * marked as Word::checked were judged with. */
   };
   /*! \brief Alias for the Watcher type. */
   using Watcher = QFutureWatcher<ResultType>;
@@ -105,21 +204,59 @@ public:
    *
    * Construct the processor for he given document, hashes for a speedup and
    * the settings that should be applied.
-   * \param documentPointer Shared ownership of the document pointer to prevent
-   *    it from getting deleted while the processor still runs.
+   *
+   * The comments and literals that must be parsed are copied out of the
+   * document in the constructor, the source and AST of the document must thus
+   * still be alive when the processor is constructed. The processor does not
+   * keep them alive after that.
+   * \param documentPointer The document that must be processed. The document
+   *    is only kept by the processor if its symbols must still be visited.
    * \param hashWords List of hashes that should be used to optimise the parsing.
-   * \param cppSettings Settings that should be applied. */
-  CppDocumentProcessor( CPlusPlus::Document::Ptr documentPointer, const HashWords& hashWords, const CppParserSettings& cppSettings );
+   * \param sourceWords Words that appeared in the source the previous time the
+   *    document was processed. They are used as is if the code of the document
+   *    did not change.
+   * \param projectIdentifiers Identifiers that appear in the other files of the
+   *    project. Words that are one of these are removed along with the words
+   *    that appear in the source of the document.
+   * \param dictionaryGeneration Current generation of the dictionary, the
+   *    mistakes kept in the hashes are only used if they were checked with
+   *    this generation.
+   * \param cppSettings Snapshot of the settings that should be applied. The
+   *    snapshot is kept for the whole job, its generation is reported with the
+   *    result.
+   * \param visibleRange Visible lines of the editor if the document is open in
+   *    the current editor. The tokens in and around the visible lines are then
+   *    parsed and reported first. The words of the tokens are also kept in the
+   *    hashes before the settings are applied to them. */
+  CppDocumentProcessor( CPlusPlus::Document::Ptr documentPointer, const HashWords& hashWords, const SourceWords& sourceWords, IdentifierSetPtr projectIdentifiers, quint64 dictionaryGeneration, CppParserSettingsSnapshot cppSettings, VisibleRangePtr visibleRange = nullptr );
   /*! Destructor. */
   ~CppDocumentProcessor() override;
   /*! \brief Process function that the thread will run with the future that will
-   * report the result. */
+   * report the result.
+   *
+   * For large files the words are reported in partial results per chunk of
+   * tokens before the final result is reported. */
   void process( Promise& promise );
 
 private:
+  /*! \brief Copy the comments and literals that must be parsed out of the
+   * translation unit of the document.
+   *
+   * Only the bytes and the position of the tokens are copied, the settings
+   * for the tokens to check and the first comment are applied while copying. */
+  void snapshotTokens();
   QStringSet getWordsThatAppearInSource() const;
-  QStringSet getListOfWordsFromSourceRecursive( const CPlusPlus::Symbol* symbol, const CPlusPlus::Overview& overview ) const;
-  QStringSet getPossibleNamesFromString( const QString& string ) const;
+  /*! \brief Add the words of the \a symbol and the symbols in its scope to \a wordsInSource. */
+  void addWordsFromSourceRecursive( const CPlusPlus::Symbol* symbol, const CPlusPlus::Overview& overview, QStringSet& wordsInSource ) const;
+  /*! \brief Add the identifiers that appear in the \a string to \a wordSet. */
+  static void addPossibleNamesFromString( const QString& string, QStringSet& wordSet );
+  /*! \brief Fingerprint of the code of the document.
+   *
+   * The fingerprint is calculated from the kinds of the tokens and the names
+   * of the identifiers. Comments and the contents of literals are not part of
+   * the fingerprint, edits to them does not change the symbols of the
+   * document. */
+  static quint64 codeFingerprint( const CPlusPlus::TranslationUnit* trUnit );
 
   /*! \brief Parse a Token retrieved from the Translation Unit of the document.
    *
@@ -139,24 +276,28 @@ private:
    * was not as much but on smaller files this effect is negligible compared
    * to the speedup on large files.
    *
-   * \param[in] token Translation Unit Token that should be split up into words that
-   *              should be checked.
-   * \param[in] type If the token is a Comment, Doxygen Documentation or a
-   *              String Literal. This is captured to go along with the
-   *              word so that the tables and displays upstream can indicate
-   *              the difference between a comment and a literal. This gets
-   *              forwarded to the extractWordsFromString() function where it
-   *              is used to extract words.
+   * \param[in] span Token from the snapshot that should be split up into words
+   *              that should be checked. The type of the span indicates if the
+   *              token is a Comment, Doxygen Documentation or a String Literal.
+   *              This is captured to go along with the word so that the tables
+   *              and displays upstream can indicate the difference between a
+   *              comment and a literal.
    * \return WordTokens structure containing enough information to be useful to
-   *              the caller. */
-  WordTokens parseToken( const CPlusPlus::Token& token, WordTokens::Type type ) const;
+   *              the caller. The hash is 0 if the token does not decode to
+   *              the number of characters in the span. */
+  WordTokens parseToken( const TokenSpan& span ) const;
   /*! \brief Extract Words from the given string.
    *
    * This function takes a string, either a comment or a string literal and
    * breaks the string into words or tokens that should later be checked
    * for spelling mistakes.
+   * The text of the words refers to the data of \a string, the caller must
+   * copy the text of the words that are kept for longer than the string.
    * \param[in] string String that must be broken up into words.
-   * \param[in] stringStart Start of the string.
+   * \param[in] line Line of the first character of the string.
+   * \param[in] column Column of the first character of the string. The
+   *              positions of the words are tracked from this position while
+   *              the string is scanned.
    * \param[in] type If the string is a Comment, Doxygen Documentation or a
    *              String Literal. If the string is Doxygen docs then the
    *              function will also try to remove doxygen tags from the words
@@ -164,7 +305,7 @@ private:
    *              gets handled later on, and it does not rely on a setting,
    *              it must be done always to remove noise.
    * \return Words that were extracted from the string. */
-  WordList extractWordsFromString(const QString& string, int32_t stringStart, WordTokens::Type type ) const;
+  WordList extractWordsFromString( const QString& string, int32_t line, int32_t column, WordTokens::Type type ) const;
   /*! \brief Check if the end of a possible word was reached.
    *
    * Utility function to check if the character at the given position is the
@@ -176,12 +317,6 @@ private:
    * using an iterator instead of an index. This would possibly require
    * rework in the calling function as well, but might be cleaner. */
   bool isEndOfCurrentWord( const QString& comment, int currentPos ) const;
-  /*! \brief Parse all macros in the document and extract string literals.
-   *
-   * Only macros that are functions and have arguments that are string literals
-   * are considered. This is important since QStringLiteral() is a macro, and
-   * there are also other macros that takes in literals as arguments. */
-  QVector<WordTokens> parseMacros() const;
 
   /*! \brief Custom type for the checkHash() return type.
    *
@@ -208,7 +343,27 @@ private:
    * without any more processing on the second string. The usefulness
    * of this is probably not much since strings should not normally repeat.
    * People should use the DRY principal... */
-  TmpOptional checkHash( WordTokens tokens, uint32_t hash ) const;
+  TmpOptional checkHash( WordTokens tokens ) const;
+  /*! \brief Collect the words of a parsed token.
+   *
+   * Apply the settings to the words of the token if they are new and add
+   * the token to the hashes and its words to the list of words. If the
+   * mistakes among the words of the token are known, only the mistakes are
+   * added to the list of words, marked as Word::checked.
+   * \return Fingerprint of the token and the words that it added, without
+   *    their positions. 0 if the mistakes of the token were not known, 1 if
+   *    the token was rejected by parseToken() and is not added to the hashes.
+   * \param[in] tokens Token that was parsed using parseToken().
+   * \param[in] wordsInSource Words that appear in the source.
+   * \param[inout] hashesOut Hashes that the token must be added to.
+   * \param[inout] wordsOut List of words that the words of the token gets added to. */
+  quint64 collectTokenWords( const WordTokens& tokens, const QStringSet& wordsInSource, HashWords& hashesOut, WordList& wordsOut ) const;
+  /*! \brief Order the \a tokens by their distance to the visible \a range.
+   *
+   * Tokens in the visible lines, or less than a page away from them, come
+   * first in their original order, followed by the other tokens moving outward
+   * from the visible lines. */
+  static void orderByVisibleRange( TokenSpan* begin, TokenSpan* end, quint64 range );
 
   friend CppDocumentProcessorPrivate;
   CppDocumentProcessorPrivate* const d;
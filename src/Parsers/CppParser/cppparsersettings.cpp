@@ -129,8 +129,8 @@ void CppParserSettings::setDefaults()
 
 CppParserSettings& CppParserSettings::operator=( const CppParserSettings& other )
 {
-  bool settingsSame = ( operator==( other ) );
-  if( settingsSame == false ) {
+  const SettingsChanges changed = changes( other );
+  if( changed != SettingsChange::None ) {
     this->whatToCheck                   = other.whatToCheck;
     this->commentsToCheck               = other.commentsToCheck;
     this->checkQtKeywords               = other.checkQtKeywords;
@@ -143,7 +143,7 @@ CppParserSettings& CppParserSettings::operator=( const CppParserSettings& other
     this->wordsWithDotsOption           = other.wordsWithDotsOption;
     this->removeWebsites                = other.removeWebsites;
     this->removeFirstComment            = other.removeFirstComment;
-    emit settingsChanged();
+    emit settingsChanged( changed );
   }
 
   return *this;
@@ -168,3 +168,28 @@ bool CppParserSettings::operator==( const CppParserSettings& other ) const
   return ( different == false );
 }
 // --------------------------------------------------
+
+SpellChecker::SettingsChanges CppParserSettings::changes( const CppParserSettings& other ) const
+{
+  SettingsChanges changed;
+  /* The settings that select the tokens that are extracted. */
+  if( ( whatToCheck != other.whatToCheck )
+      || ( commentsToCheck != other.commentsToCheck )
+      || ( removeFirstComment != other.removeFirstComment ) ) {
+    changed |= SettingsChange::Extraction;
+  }
+  /* The settings that are applied to the words extracted from the tokens. */
+  if( ( checkQtKeywords != other.checkQtKeywords )
+      || ( checkAllCapsWords != other.checkAllCapsWords )
+      || ( wordsWithNumberOption != other.wordsWithNumberOption )
+      || ( wordsWithUnderscoresOption != other.wordsWithUnderscoresOption )
+      || ( camelCaseWordOption != other.camelCaseWordOption )
+      || ( removeWordsThatAppearInSource != other.removeWordsThatAppearInSource )
+      || ( removeEmailAddresses != other.removeEmailAddresses )
+      || ( wordsWithDotsOption != other.wordsWithDotsOption )
+      || ( removeWebsites != other.removeWebsites ) ) {
+    changed |= SettingsChange::Filter;
+  }
+  return changed;
+}
+// --------------------------------------------------
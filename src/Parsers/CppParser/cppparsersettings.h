@@ -20,6 +20,9 @@
 
 #pragma once
 
+#include "../../SharedSnapshot.h"
+#include "../../spellcheckercoresettings.h"
+
 #include <utils/qtcsettings.h>
 
 #include <QObject>
@@ -153,9 +156,16 @@ public:
 
   CppParserSettings& operator=( const CppParserSettings& other );
   bool operator==( const CppParserSettings& other ) const;
+  /*! \brief Get the kinds of settings that are different in \a other.
+   *
+   * The tokens to check are extraction settings, the options on the words
+   * that are extracted are filter settings. */
+  SettingsChanges changes( const CppParserSettings& other ) const;
 
 signals:
-  void settingsChanged();
+  /*! \brief Signal emitted when the settings changed.
+   * \param changes Kinds of settings that changed. */
+  void settingsChanged( SpellChecker::SettingsChanges changes );
 
 public slots:
 
@@ -163,6 +173,9 @@ protected:
   void setDefaults();
 };
 
+/*! \brief Immutable snapshot of the settings shared with the processors. */
+using CppParserSettingsSnapshot = SharedSnapshot<CppParserSettings>::Ptr;
+
 } // namespace Internal
 } // namespace CppSpellChecker
 } // namespace SpellChecker
@@ -0,0 +1,343 @@
+/**************************************************************************
+**
+** Copyright (c) 2014 Carel Combrink
+**
+** This file is part of the SpellChecker Plugin, a Qt Creator plugin.
+**
+** The SpellChecker Plugin is free software: you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public License as
+** published by the Free Software Foundation, either version 3 of the
+** License, or (at your option) any later version.
+**
+** The SpellChecker Plugin is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with the SpellChecker Plugin.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include "Pipeline.h"
+
+#include <QMutex>
+
+#include <chrono>
+#include <deque>
+
+namespace SpellChecker {
+
+namespace {
+/*! \brief Monotonic time in micro seconds used for the latency of items. */
+qint64 nowUs()
+{
+  using namespace std::chrono;
+  return duration_cast<microseconds>( steady_clock::now().time_since_epoch() ).count();
+}
+} // namespace
+
+class PipelineStagePrivate
+{
+public:
+  QString name;
+  int32_t capacity;
+  int32_t parallelism;
+  std::atomic<int32_t> waiting{ 0 };
+  std::atomic<int32_t> queued{ 0 };
+  std::atomic<int32_t> running{ 0 };
+  // --
+  mutable QMutex mutex;            /*!< Guards the members below. */
+  CancellationToken token;
+  std::deque<qint64> waitingSince; /*!< Time that the waiting items were registered, oldest first. */
+  qint64 completed      = 0;
+  qint64 cancelled      = 0;
+  qint64 totalLatencyUs = 0;
+  qint64 maxLatencyUs   = 0;
+  qint64 batches        = 0;
+  qint64 totalBatchUs   = 0;
+  qint64 maxBatchUs     = 0;
+
+  void itemCompleted( qint64 latencyUs )
+  {
+    /* Called with the mutex locked. */
+    ++completed;
+    totalLatencyUs += latencyUs;
+    maxLatencyUs    = std::max( maxLatencyUs, latencyUs );
+  }
+
+  CancellationToken enqueue()
+  {
+    QMutexLocker locker( &mutex );
+    waitingSince.push_back( nowUs() );
+    ++waiting;
+    return token;
+  }
+};
+// --------------------------------------------------
+// --------------------------------------------------
+// --------------------------------------------------
+
+PipelineStage::PipelineStage( const QString& name, int32_t parallelism, int32_t capacity, QThread::Priority priority )
+  : d( std::make_shared<PipelineStagePrivate>() )
+  , d_priority( priority )
+{
+  d->name        = name;
+  d->capacity    = capacity;
+  d->parallelism = parallelism;
+  d_threadPool.setMaxThreadCount( parallelism );
+}
+// --------------------------------------------------
+
+PipelineStage::~PipelineStage()
+{
+  cancelAll();
+  d_threadPool.waitForDone();
+}
+// --------------------------------------------------
+
+QString PipelineStage::name() const
+{
+  return d->name;
+}
+// --------------------------------------------------
+
+int32_t PipelineStage::capacity() const
+{
+  return d->capacity;
+}
+// --------------------------------------------------
+
+int32_t PipelineStage::depth() const
+{
+  return d->waiting + d->queued + d->running;
+}
+// --------------------------------------------------
+
+bool PipelineStage::hasCapacity() const
+{
+  return depth() < d->capacity;
+}
+// --------------------------------------------------
+
+bool PipelineStage::canStart() const
+{
+  return ( d->queued + d->running ) < d->capacity;
+}
+// --------------------------------------------------
+
+CancellationToken PipelineStage::token() const
+{
+  QMutexLocker locker( &d->mutex );
+  return d->token;
+}
+// --------------------------------------------------
+
+void PipelineStage::cancelAll()
+{
+  QMutexLocker locker( &d->mutex );
+  d->token.cancel();
+  d->token      = CancellationToken();
+  d->cancelled += qint64( d->waitingSince.size() );
+  d->waitingSince.clear();
+  d->waiting    = 0;
+}
+// --------------------------------------------------
+
+PipelineStage::Statistics PipelineStage::statistics() const
+{
+  Statistics statistics;
+  statistics.name        = d->name;
+  statistics.capacity    = d->capacity;
+  statistics.parallelism = d->parallelism;
+  statistics.waiting     = d->waiting;
+  statistics.queued      = d->queued;
+  statistics.running     = d->running;
+  QMutexLocker locker( &d->mutex );
+  statistics.completed      = d->completed;
+  statistics.cancelled      = d->cancelled;
+  statistics.totalLatencyUs = d->totalLatencyUs;
+  statistics.maxLatencyUs   = d->maxLatencyUs;
+  statistics.batches        = d->batches;
+  statistics.totalBatchUs   = d->totalBatchUs;
+  statistics.maxBatchUs     = d->maxBatchUs;
+  return statistics;
+}
+// --------------------------------------------------
+
+CancellationToken PipelineStage::enqueue()
+{
+  return d->enqueue();
+}
+// --------------------------------------------------
+
+void PipelineStage::dequeue( const CancellationToken& token )
+{
+  QMutexLocker locker( &d->mutex );
+  if( ( token.isCancelled() == true )
+      || ( d->waitingSince.empty() == true ) ) {
+    /* The stage was cancelled after the item was registered. */
+    return;
+  }
+  d->itemCompleted( nowUs() - d->waitingSince.front() );
+  d->waitingSince.pop_front();
+  --d->waiting;
+}
+// --------------------------------------------------
+
+void PipelineStage::recordBatch( qint64 durationUs )
+{
+  QMutexLocker locker( &d->mutex );
+  ++d->batches;
+  d->totalBatchUs += durationUs;
+  d->maxBatchUs    = std::max( d->maxBatchUs, durationUs );
+}
+// --------------------------------------------------
+
+PipelineStage::JobTicket PipelineStage::jobQueued( const std::shared_ptr<PipelineStagePrivate>& state )
+{
+  ++state->queued;
+  QMutexLocker locker( &state->mutex );
+  return JobTicket{ nowUs(), state->token };
+}
+// --------------------------------------------------
+
+void PipelineStage::jobStarted( const std::shared_ptr<PipelineStagePrivate>& state )
+{
+  --state->queued;
+  ++state->running;
+}
+// --------------------------------------------------
+
+void PipelineStage::jobSkipped( const std::shared_ptr<PipelineStagePrivate>& state )
+{
+  --state->queued;
+  QMutexLocker locker( &state->mutex );
+  ++state->cancelled;
+}
+// --------------------------------------------------
+
+void PipelineStage::jobFinished( const std::shared_ptr<PipelineStagePrivate>& state, const JobTicket& ticket, bool completed )
+{
+  QMutexLocker locker( &state->mutex );
+  if( ( completed == true )
+      && ( ticket.token.isCancelled() == false ) ) {
+    state->itemCompleted( nowUs() - ticket.queuedAtUs );
+  } else {
+    ++state->cancelled;
+  }
+  --state->running;
+}
+// --------------------------------------------------
+// --------------------------------------------------
+// --------------------------------------------------
+
+class PipelinePrivate
+{
+public:
+  std::unique_ptr<PipelineStage> stages[Pipeline::StageCount];
+  std::atomic_bool throttled{ false };
+};
+// --------------------------------------------------
+// --------------------------------------------------
+// --------------------------------------------------
+
+Pipeline::Pipeline( QObject* parent )
+  : QObject( parent )
+  , d( new PipelinePrivate() )
+{
+  const int32_t threads = std::max( 1, QThread::idealThreadCount() );
+  /* Parsing is mostly CPU bound and can use all cores. The capacity of 10
+   * matches the number of files the C++ parser used to keep in process. */
+  d->stages[Parse] = std::make_unique<PipelineStage>( QStringLiteral( "Parse" ), threads, 10, QThread::NormalPriority );
+  /* The spell checkers guard their dictionaries with a lock, more than a
+   * couple of threads checking at the same time will only wait on each
+   * other. */
+  d->stages[Check] = std::make_unique<PipelineStage>( QStringLiteral( "Check" ), std::min( 2, threads ), 16, QThread::LowPriority );
+  /* Publishing happens in the GUI thread and does not run jobs on the pool.
+   * Results are published in batches at an interval, the capacity allows a
+   * few batches to wait before the parsers are held back. */
+  d->stages[Publish] = std::make_unique<PipelineStage>( QStringLiteral( "Publish" ), 1, 256, QThread::NormalPriority );
+}
+// --------------------------------------------------
+
+Pipeline::~Pipeline()
+{
+  cancelAll();
+  delete d;
+}
+// --------------------------------------------------
+
+PipelineStage* Pipeline::stage( Stage stage ) const
+{
+  Q_ASSERT( ( stage >= Parse ) && ( stage < StageCount ) );
+  return d->stages[stage].get();
+}
+// --------------------------------------------------
+
+bool Pipeline::hasCapacityFrom( Stage stage ) const
+{
+  for( int32_t index = stage; index < StageCount; ++index ) {
+    if( d->stages[index]->hasCapacity() == false ) {
+      d->throttled = true;
+      return false;
+    }
+  }
+  return true;
+}
+// --------------------------------------------------
+
+void Pipeline::notifyCapacity()
+{
+  if( d->throttled == false ) {
+    return;
+  }
+  /* Only the downstream stages are checked, the upstream user will check
+   * its own stage when it gets notified. */
+  if( ( d->stages[Check]->hasCapacity() == true )
+      && ( d->stages[Publish]->hasCapacity() == true ) ) {
+    d->throttled = false;
+    emit capacityAvailable();
+  }
+}
+// --------------------------------------------------
+
+void Pipeline::cancelAll()
+{
+  for( const std::unique_ptr<PipelineStage>& stage: d->stages ) {
+    stage->cancelAll();
+  }
+}
+// --------------------------------------------------
+
+QList<PipelineStage::Statistics> Pipeline::statistics() const
+{
+  QList<PipelineStage::Statistics> statistics;
+  for( const std::unique_ptr<PipelineStage>& stage: d->stages ) {
+    statistics << stage->statistics();
+  }
+  return statistics;
+}
+// --------------------------------------------------
+
+} // namespace SpellChecker
+
+QDebug operator<<( QDebug debug, const SpellChecker::PipelineStage::Statistics& statistics )
+{
+  QDebugStateSaver saver( debug );
+  debug.nospace() << statistics.name
+                  << "(depth: " << statistics.depth() << "/" << statistics.capacity
+                  << ", waiting: " << statistics.waiting
+                  << ", queued: " << statistics.queued
+                  << ", running: " << statistics.running << "/" << statistics.parallelism
+                  << ", completed: " << statistics.completed
+                  << ", cancelled: " << statistics.cancelled
+                  << ", latency avg: " << statistics.averageLatencyUs() << "us"
+                  << ", max: " << statistics.maxLatencyUs << "us";
+  if( statistics.batches > 0 ) {
+    debug << ", batches: " << statistics.batches
+          << ", batch avg: " << statistics.averageBatchUs() << "us"
+          << ", max: " << statistics.maxBatchUs << "us";
+  }
+  debug << ")";
+  return debug;
+}
@@ -0,0 +1,289 @@
+/**************************************************************************
+**
+** Copyright (c) 2014 Carel Combrink
+**
+** This file is part of the SpellChecker Plugin, a Qt Creator plugin.
+**
+** The SpellChecker Plugin is free software: you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public License as
+** published by the Free Software Foundation, either version 3 of the
+** License, or (at your option) any later version.
+**
+** The SpellChecker Plugin is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with the SpellChecker Plugin.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#pragma once
+
+#include <utils/async.h>
+
+#include <QDebug>
+#include <QFuture>
+#include <QObject>
+#include <QPromise>
+#include <QThreadPool>
+
+#include <atomic>
+#include <memory>
+
+namespace SpellChecker {
+
+/*! \brief The CancellationToken class
+ *
+ * Token shared between a pipeline stage and the jobs that it started. All
+ * copies of a token refer to the same flag, cancelling the token will thus
+ * cancel all jobs that were handed that token. */
+class CancellationToken
+{
+public:
+  /*! \brief Constructor, creates a new token that is not cancelled. */
+  CancellationToken()
+    : d_cancelled( std::make_shared<std::atomic_bool>( false ) )
+  {}
+  /*! \brief Cancel the token and all copies of the token. */
+  void cancel() const
+  {
+    d_cancelled->store( true );
+  }
+  /*! \brief Check if the token was cancelled. */
+  bool isCancelled() const
+  {
+    return d_cancelled->load();
+  }
+private:
+  std::shared_ptr<std::atomic_bool> d_cancelled;
+};
+// --------------------------------------------------
+// --------------------------------------------------
+// --------------------------------------------------
+
+class PipelineStagePrivate;
+/*! \brief The PipelineStage class
+ *
+ * A stage in the processing pipeline of the plugin. A stage has a bounded
+ * capacity and its own thread pool that limits the number of jobs that can
+ * run in parallel on the stage.
+ *
+ * The depth of a stage is the number of items handed to the stage that
+ * were not completed yet. Items are either jobs started using run(), or items
+ * that are waiting in a buffer owned by the user of the stage, registered with
+ * enqueue() and dequeue(). The latter is used for stages that do not run on a
+ * thread pool, like publishing results in the GUI thread.
+ *
+ * A stage does not refuse work when it is full, it is up to the upstream users
+ * to check hasCapacity() and hold back. This is what implements the backpressure
+ * between stages.
+ *
+ * All functions are thread safe. */
+class PipelineStage
+{
+  PipelineStage( const PipelineStage& )            = delete;
+  PipelineStage& operator=( const PipelineStage& ) = delete;
+public:
+  /*! \brief Statistics of a stage. */
+  struct Statistics
+  {
+    QString name;               /*!< Name of the stage. */
+    int32_t capacity      = 0;  /*!< Maximum depth before the stage is full. */
+    int32_t parallelism   = 0;  /*!< Number of jobs that can run at the same time. */
+    int32_t waiting       = 0;  /*!< Items waiting in a buffer for the stage. */
+    int32_t queued        = 0;  /*!< Jobs started but waiting for a thread. */
+    int32_t running       = 0;  /*!< Jobs currently running. */
+    qint64 completed      = 0;  /*!< Number of items completed. */
+    qint64 cancelled      = 0;  /*!< Number of jobs cancelled. */
+    qint64 totalLatencyUs = 0;  /*!< Sum of the latency of all completed items. */
+    qint64 maxLatencyUs   = 0;  /*!< Worst latency of a completed item. */
+    qint64 batches        = 0;  /*!< Number of batches recorded with recordBatch(). */
+    qint64 totalBatchUs   = 0;  /*!< Sum of the duration of all batches. */
+    qint64 maxBatchUs     = 0;  /*!< Longest duration of a batch. */
+    /*! \brief Depth of the stage, all items not completed. */
+    int32_t depth() const { return waiting + queued + running; }
+    /*! \brief Average latency from entering the stage to completion. */
+    qint64 averageLatencyUs() const { return ( completed > 0 ) ? ( totalLatencyUs / completed ) : 0; }
+    /*! \brief Average duration of a batch. */
+    qint64 averageBatchUs() const { return ( batches > 0 ) ? ( totalBatchUs / batches ) : 0; }
+  };
+
+  /*! \brief Constructor
+   * \param name Name of the stage used for reporting.
+   * \param parallelism Maximum number of jobs that will run at the same time.
+   * \param capacity Depth at which the stage reports that it is full.
+   * \param priority Thread priority of jobs that are not urgent. */
+  PipelineStage( const QString& name, int32_t parallelism, int32_t capacity, QThread::Priority priority );
+  /*! \brief Destructor
+   *
+   * Cancels all jobs and waits for the jobs on the stage thread pool. */
+  ~PipelineStage();
+
+  /*! \brief Name of the stage. */
+  QString name() const;
+  /*! \brief Depth at which the stage is regarded as full. */
+  int32_t capacity() const;
+  /*! \brief Number of items in the stage that were not completed. */
+  int32_t depth() const;
+  /*! \brief Check if the stage can accept more items.
+   *
+   * This is the check upstream users should do before handing items to
+   * the stage. */
+  bool hasCapacity() const;
+  /*! \brief Check if an item waiting for the stage can be started as a job.
+   *
+   * Only the jobs are counted, waiting items do not prevent each other from
+   * being started. */
+  bool canStart() const;
+  /*! \brief Current cancellation token that is handed to new jobs. */
+  CancellationToken token() const;
+  /*! \brief Cancel all jobs and items on the stage.
+   *
+   * The current token is cancelled and a new one is created for jobs started
+   * after this call. Items waiting in buffers are forgotten, the owner of the
+   * buffer is expected to clear it as well. */
+  void cancelAll();
+  /*! \brief Get a snapshot of the statistics of the stage. */
+  Statistics statistics() const;
+  /*! \brief Register an item that waits for the stage outside of a job.
+   * \return The token of the stage that must be handed to dequeue(). */
+  CancellationToken enqueue();
+  /*! \brief Complete the oldest item registered with enqueue().
+   *
+   * The \a token is the one that enqueue() returned for the item. If the
+   * stage was cancelled since, the item was already forgotten and the call
+   * is ignored. */
+  void dequeue( const CancellationToken& token );
+  /*! \brief Record the \a durationUs that it took to complete a batch of items.
+   *
+   * Used by stages that complete waiting items in batches to measure the
+   * cost of each batch. */
+  void recordBatch( qint64 durationUs );
+
+  /*! \brief Run a job on the stage.
+   *
+   * The \a function member of \a object will be called in a thread with the
+   * promise of the returned future. If the job is \a urgent it does not get
+   * queued on the stage thread pool but gets its own high priority thread,
+   * this is used for the file in the current editor. Urgent jobs still
+   * count towards the depth of the stage.
+   *
+   * If the stage is cancelled before the job starts, the function is not
+   * called and the future is cancelled. If the returned future is cancelled
+   * before the job starts, the job is never called, it is removed from the
+   * queued jobs of the stage when the future finishes. */
+  template<typename ResultType, typename Class>
+  QFuture<ResultType> run( bool urgent, void ( Class::*function )( QPromise<ResultType>& ), Class* object )
+  {
+    const std::shared_ptr<PipelineStagePrivate> state = d;
+    const JobTicket ticket = jobQueued( state );
+    /* Set once the job is either started or skipped, only one of them may
+     * take the job from the queued jobs. */
+    const std::shared_ptr<std::atomic_bool> dequeued = std::make_shared<std::atomic_bool>( false );
+    auto job = [state, ticket, dequeued, function, object]( QPromise<ResultType>& promise ) {
+      dequeued->store( true );
+      jobStarted( state );
+      if( ticket.token.isCancelled() == true ) {
+        promise.future().cancel();
+      } else {
+        ( object->*function )( promise );
+      }
+      jobFinished( state, ticket, promise.isCanceled() == false );
+    };
+    QFuture<ResultType> future = ( urgent == true )
+                                 ? Utils::asyncRun( QThread::HighPriority, std::move( job ) )
+                                 : Utils::asyncRun( &d_threadPool, d_priority, std::move( job ) );
+    /* The continuation runs when the cancelled future finished, after the
+     * job if it was started. */
+    future.onCanceled( [state, dequeued]() {
+      if( dequeued->exchange( true ) == false ) {
+        jobSkipped( state );
+      }
+      return ResultType();
+    } );
+    return future;
+  }
+
+private:
+  /*! \brief Bookkeeping for a job that was started. */
+  struct JobTicket
+  {
+    qint64 queuedAtUs;       /*!< Time that the job was queued. */
+    CancellationToken token; /*!< Token at the time the job was queued. */
+  };
+  static JobTicket jobQueued( const std::shared_ptr<PipelineStagePrivate>& state );
+  static void jobStarted( const std::shared_ptr<PipelineStagePrivate>& state );
+  static void jobSkipped( const std::shared_ptr<PipelineStagePrivate>& state );
+  static void jobFinished( const std::shared_ptr<PipelineStagePrivate>& state, const JobTicket& ticket, bool completed );
+
+  /* The state is shared with the running jobs so that a job that outlives
+   * the stage, like an urgent job, does not access a deleted object. The
+   * thread pool is kept out of the shared state on purpose, its destructor
+   * waits on its threads and must never run in one of them. */
+  std::shared_ptr<PipelineStagePrivate> d;
+  QThreadPool d_threadPool;
+  QThread::Priority d_priority;
+};
+// --------------------------------------------------
+// --------------------------------------------------
+// --------------------------------------------------
+
+class PipelinePrivate;
+/*! \brief The Pipeline class
+ *
+ * The pipeline that words travel through from the document parsers to the
+ * mistakes shown in the GUI:
+ *  - Parse: Document parsers extracting and filtering words from files.
+ *  - Check: The spell checker checking the words of a file.
+ *  - Publish: Results that must still be added to the models and editor in
+ *      the GUI thread.
+ *
+ * The pipeline is owned by the SpellCheckerCore and is available to the
+ * parsers through SpellCheckerCore::pipeline(). */
+class Pipeline
+  : public QObject
+{
+  Q_OBJECT
+public:
+  /*! \brief The stages of the pipeline in the order that data flows. */
+  enum Stage {
+    Parse = 0,
+    Check,
+    Publish,
+    StageCount
+  };
+
+  explicit Pipeline( QObject* parent = nullptr );
+  ~Pipeline() override;
+
+  /*! \brief Get the given \a stage. */
+  PipelineStage* stage( Stage stage ) const;
+  /*! \brief Check if \a stage and all stages after it have capacity.
+   *
+   * This is the backpressure check that an upstream user should do before
+   * handing more work to \a stage. If there is no capacity the pipeline
+   * remembers that it throttled a user and will emit capacityAvailable()
+   * from notifyCapacity() once there is capacity again. */
+  bool hasCapacityFrom( Stage stage ) const;
+  /*! \brief Notify throttled users if the pipeline has capacity again.
+   *
+   * Must be called by the consumers of stages after they completed items. */
+  void notifyCapacity();
+  /*! \brief Cancel all stages. */
+  void cancelAll();
+  /*! \brief Get the statistics of all stages. */
+  QList<PipelineStage::Statistics> statistics() const;
+
+signals:
+  /*! \brief Signal emitted when a user was throttled and there is capacity
+   * again. */
+  void capacityAvailable();
+
+private:
+  PipelinePrivate* const d;
+};
+
+} // namespace SpellChecker
+
+QDebug operator<<( QDebug debug, const SpellChecker::PipelineStage::Statistics& statistics );
@@ -24,12 +24,61 @@
 #include <coreplugin/editormanager/ieditor.h>
 
 #include <QFileInfo>
+#include <QSet>
+
+#include <iterator>
+#include <numeric>
 
 using namespace SpellChecker::Internal;
 using namespace SpellChecker;
 
-using WordListInternalPair = QPair<SpellChecker::WordList, bool /* In Startup Project */>;
-using FileMistakes         = QMap<QString, WordListInternalPair>;
+/*! \brief Mistakes of a file in the model. */
+struct FileMistakesEntry
+{
+  QVector<SpellChecker::Word> words; /*!< The mistakes of the file in the order they were set. */
+  bool inStartupProject = false;
+  QVector<int32_t> positions; /*!< Indexes into the \a words sorted on line and column. This
+                               * index is used to find the mistake at a position without
+                               * iterating all words of the file. */
+  QHash<QString, QVector<int32_t>> occurrences; /*!< Indexes into the \a words of each text,
+                                                 * sorted on line and column. */
+  int32_t literalCount = 0;   /*!< Number of \a words in String Literals. */
+  /* The name and suffix are shown for each row and the upper case versions
+   * are used as the sort keys. They are created once when the file is added
+   * instead of on each comparison. */
+  QString name;
+  QString suffix;
+  QString nameKey;
+  QString suffixKey;
+  QString pathKey;
+};
+using FileMistakes = QHash<QString, FileMistakesEntry>;
+/*! \brief Number of occurrences of a word in each file that contains it. */
+using WordFiles = QHash<QString /* File name */, int32_t /* Occurrences */>;
+
+namespace {
+/*! \brief Number of updated files in a batch from which the files are sorted
+ * with one layout change instead of moving them one by one. */
+constexpr int32_t cLAYOUT_CHANGE_FILES = 16;
+
+/*! \brief Check if the position of \a lhs is before the position of \a rhs. */
+bool positionLessThan( const Word& lhs, const Word& rhs )
+{
+  return ( lhs.lineNumber < rhs.lineNumber )
+         || ( ( lhs.lineNumber == rhs.lineNumber )
+              && ( lhs.columnNumber < rhs.columnNumber ) );
+}
+/*! \brief Create the positional index of the \a words. */
+QVector<int32_t> positionIndex( const QVector<Word>& words )
+{
+  QVector<int32_t> positions( words.size() );
+  std::iota( positions.begin(), positions.end(), 0 );
+  std::sort( positions.begin(), positions.end(), [&words]( int32_t lhs, int32_t rhs ) {
+    return positionLessThan( words.at( lhs ), words.at( rhs ) );
+  } );
+  return positions;
+}
+} // namespace
 
 class SpellChecker::Internal::ProjectMistakesModelPrivate
 {
@@ -44,10 +93,171 @@ public:
                               * items in a sorted manner. */
   ProjectMistakesModel::Columns sortedColumn;
   Qt::SortOrder sortOrder;
+  QHash<QString, WordFiles> wordIndex;  /*!< The files that contain each misspelled word, kept
+                                         * up to date as files are added and removed. */
+  mutable QHash<QString, int32_t> rows; /*!< Row of each file in the \a sortedKeys. */
+  mutable int32_t rowsValidBefore = 0;  /*!< The \a rows are only correct for the rows before
+                                         * this row. Rows after a row that was inserted or
+                                         * removed are updated when they are needed. */
 
   ProjectMistakesModelPrivate()
     : sortedColumn( ProjectMistakesModel::COLUMN_FILE )
     , sortOrder( Qt::AscendingOrder ) {}
+
+  /*! \brief Set the \a words of the file \a fileName and update the word
+   * index and the cached values. */
+  void setWords( const QString& fileName, FileMistakesEntry& entry, const WordList& words )
+  {
+    unindexWords( fileName, entry.words );
+    entry.words.clear();
+    entry.words.reserve( words.size() );
+    for( const Word& word: words ) {
+      entry.words.append( word );
+    }
+    indexWords( fileName, entry.words );
+    updateCachedValues( entry );
+  }
+
+  /*! \brief Update the values cached for the words of a file \a entry. */
+  void updateCachedValues( FileMistakesEntry& entry ) const
+  {
+    entry.positions    = positionIndex( entry.words );
+    entry.occurrences.clear();
+    for( const int32_t index: qAsConst( entry.positions ) ) {
+      entry.occurrences[entry.words.at( index ).text].append( index );
+    }
+    entry.literalCount = int32_t( std::count_if( entry.words.constBegin(),
+                                                 entry.words.constEnd(),
+                                                 []( const Word& word ) { return ( word.inComment == false ); } ) );
+  }
+
+  /*! \brief Add the \a words of a file to the word index. */
+  void indexWords( const QString& fileName, const QVector<Word>& words )
+  {
+    for( const Word& word: words ) {
+      ++wordIndex[word.text][fileName];
+    }
+  }
+
+  /*! \brief Remove the \a words of a file from the word index. */
+  void unindexWords( const QString& fileName, const QVector<Word>& words )
+  {
+    for( const Word& word: words ) {
+      QHash<QString, WordFiles>::iterator files = wordIndex.find( word.text );
+      if( files == wordIndex.end() ) {
+        continue;
+      }
+      WordFiles::iterator file = files.value().find( fileName );
+      if( ( file != files.value().end() )
+          && ( --file.value() <= 0 ) ) {
+        files.value().erase( file );
+        if( files.value().isEmpty() == true ) {
+          wordIndex.erase( files );
+        }
+      }
+    }
+  }
+
+  /*! \brief Create the entry for a file that gets added. */
+  FileMistakesEntry createEntry( const QString& fileName, const WordList& words, bool inStartupProject )
+  {
+    const QFileInfo info( fileName );
+    FileMistakesEntry entry;
+    entry.inStartupProject = inStartupProject;
+    entry.name             = info.fileName();
+    entry.suffix           = info.suffix();
+    entry.nameKey          = entry.name.toUpper();
+    entry.suffixKey        = entry.suffix.toUpper();
+    entry.pathKey          = fileName.toUpper();
+    setWords( fileName, entry, words );
+    return entry;
+  }
+
+  /*! \brief Check if the file \a lhs must be listed before the file \a rhs
+   * for the current sort column and order. */
+  bool lessThan( const QString& lhs, const QString& rhs ) const
+  {
+    const FileMistakes::ConstIterator iterLhs = spellingMistakes.constFind( lhs );
+    const FileMistakes::ConstIterator iterRhs = spellingMistakes.constFind( rhs );
+    if( ( iterLhs == spellingMistakes.constEnd() )
+        || ( iterRhs == spellingMistakes.constEnd() ) ) {
+      /* This should not be possible */
+      Q_ASSERT( false );
+      return false;
+    }
+    const FileMistakesEntry& entryLhs = iterLhs.value();
+    const FileMistakesEntry& entryRhs = iterRhs.value();
+
+    /* Check to see if both files are internal or external to the current project.
+     * If the LHS is internal and RHS not, the internal one is always greater than
+     * the external one. If they are both either internal or external, then sort
+     * them on the requested column.
+     * This ensures that the files are grouped together based on internal or external
+     * and then sorted according to name. The external files will always be listed last. */
+    if( entryLhs.inStartupProject != entryRhs.inStartupProject ) {
+      return entryLhs.inStartupProject;
+    }
+    /* For a descending order the arguments are swapped instead of inverting
+     * the result, so that equal files are never less than each other. */
+    return ( sortOrder == Qt::AscendingOrder )
+           ? columnLessThan( entryLhs, entryRhs )
+           : columnLessThan( entryRhs, entryLhs );
+  }
+
+  /*! \brief Compare two files on the sorted column only. */
+  bool columnLessThan( const FileMistakesEntry& lhs, const FileMistakesEntry& rhs ) const
+  {
+    switch( sortedColumn ) {
+      case ProjectMistakesModel::COLUMN_COUNT:
+      case ProjectMistakesModel::COLUMN_FILE_IN_STARTUP:
+        /* The files are already grouped on this. */
+        return false;
+      case ProjectMistakesModel::COLUMN_FILE:
+        return ( lhs.nameKey < rhs.nameKey );
+      case ProjectMistakesModel::COLUMN_MISTAKES_TOTAL:
+        return ( lhs.words.count() < rhs.words.count() );
+      case ProjectMistakesModel::COLUMN_FILEPATH:
+        return ( lhs.pathKey < rhs.pathKey );
+      case ProjectMistakesModel::COLUMN_LITERAL_COUNT:
+        return ( lhs.literalCount < rhs.literalCount );
+      case ProjectMistakesModel::COLUMN_FILE_TYPE:
+        if( lhs.suffixKey == rhs.suffixKey ) {
+          return ( lhs.nameKey < rhs.nameKey );
+        }
+        return ( lhs.suffixKey < rhs.suffixKey );
+    }
+    return false;
+  }
+
+  /*! \brief Get the row that \a fileName must be inserted at to keep the
+   * files sorted. The file must not be in the \a sortedKeys. */
+  int32_t sortedRow( const QString& fileName ) const
+  {
+    const auto iter = std::upper_bound( sortedKeys.constBegin(), sortedKeys.constEnd(), fileName,
+                                        [this]( const QString& lhs, const QString& rhs ) { return lessThan( lhs, rhs ); } );
+    return int32_t( iter - sortedKeys.constBegin() );
+  }
+
+  /*! \brief Get the row of the file, or -1 if the file is not in the model. */
+  int32_t rowOf( const QString& fileName ) const
+  {
+    const QHash<QString, int32_t>::ConstIterator iter = rows.constFind( fileName );
+    if( ( iter != rows.constEnd() )
+        && ( iter.value() < rowsValidBefore ) ) {
+      return iter.value();
+    }
+    for( int32_t row = rowsValidBefore; row < sortedKeys.size(); ++row ) {
+      rows.insert( sortedKeys.at( row ), row );
+    }
+    rowsValidBefore = int32_t( sortedKeys.size() );
+    return rows.value( fileName, -1 );
+  }
+
+  /*! \brief Notify that the rows from \a row onward changed. */
+  void invalidateRows( int32_t row )
+  {
+    rowsValidBefore = std::min( rowsValidBefore, row );
+  }
 };
 // --------------------------------------------------
 // --------------------------------------------------
@@ -82,8 +292,11 @@ void ProjectMistakesModel::insertSpellingMistakes( const QString& fileName, cons
     int idx = indexOfFile( fileName );
     Q_ASSERT( idx != -1 );
     beginRemoveRows( QModelIndex(), idx, idx );
-    d->spellingMistakes.remove( fileName );
-    d->sortedKeys.removeAll( fileName );
+    d->unindexWords( fileName, file.value().words );
+    d->spellingMistakes.erase( file );
+    d->sortedKeys.removeAt( idx );
+    d->rows.remove( fileName );
+    d->invalidateRows( idx );
     endRemoveRows();
     return;
   }
@@ -91,23 +304,104 @@ void ProjectMistakesModel::insertSpellingMistakes( const QString& fileName, cons
   /* So there are misspelled words */
   if( file != d->spellingMistakes.end() ) {
     /* The file was added with mistakes before, check if there are a change in the
-     * total number of items. */
-    bool changed = ( file.value().first.count() != words.count() );
+     * number of items. */
+    bool changed = ( file.value().words.count() != words.count() );
+    const int32_t literalCount = file.value().literalCount;
     /* Assign the words to the file */
-    file.value().first = words;
-    /* Notify of the change if there was one */
+    d->setWords( fileName, file.value(), words );
+    changed = ( changed || ( literalCount != file.value().literalCount ) );
+    /* Notify of the change if there was one, the file might have to move to
+     * keep the files sorted on the counts. */
     if( changed == true ) {
-      int idx = indexOfFile( fileName );
-      Q_ASSERT( idx != -1 );
-      emit dataChanged( index( idx, 0, QModelIndex() ), index( idx, columnCount( QModelIndex() ), QModelIndex() ) );
+      moveToSortedRow( fileName );
     }
   } else {
-    /* Insert the mistakes for the file. The model is not notified of the
-     * change here since the sort() function will in any case invalidate
-     * all of the views and they will get refreshed after that. */
-    d->spellingMistakes.insert( fileName, qMakePair( words, inStartupProject ) );
-    d->sortedKeys.append( fileName );
-    sort( static_cast<int>( d->sortedColumn ), d->sortOrder );
+    /* Insert the mistakes for the file at the row that keeps the files
+     * sorted. */
+    d->spellingMistakes.insert( fileName, d->createEntry( fileName, words, inStartupProject ) );
+    const int32_t row = d->sortedRow( fileName );
+    beginInsertRows( QModelIndex(), row, row );
+    d->sortedKeys.insert( row, fileName );
+    d->invalidateRows( row );
+    endInsertRows();
+  }
+}
+// --------------------------------------------------
+
+void ProjectMistakesModel::insertSpellingMistakes( const QList<FileUpdate>& updates )
+{
+  /* Files without mistakes are removed one by one. If many files already in
+   * the model are updated, their words are set first and the files that
+   * changed are sorted together, otherwise each file is moved on its own.
+   * The new files are inserted after that. */
+  const bool sortTogether = ( std::count_if( updates.constBegin(), updates.constEnd(), [this]( const FileUpdate& update ) {
+                                return ( update.words.isEmpty() == false )
+                                       && ( d->spellingMistakes.contains( update.fileName ) == true );
+                              } ) >= cLAYOUT_CHANGE_FILES );
+  QList<const FileUpdate*> newFiles;
+  QStringList changedFiles;
+  for( const FileUpdate& update: updates ) {
+    const FileMistakes::iterator file = d->spellingMistakes.find( update.fileName );
+    if( file == d->spellingMistakes.end() ) {
+      if( update.words.isEmpty() == false ) {
+        newFiles.append( &update );
+      }
+    } else if( update.words.isEmpty() == true ) {
+      insertSpellingMistakes( update.fileName, update.words, update.inStartupProject );
+    } else {
+      const int32_t count        = int32_t( file.value().words.count() );
+      const int32_t literalCount = file.value().literalCount;
+      d->setWords( update.fileName, file.value(), update.words );
+      if( ( count == file.value().words.count() )
+          && ( literalCount == file.value().literalCount ) ) {
+        continue;
+      }
+      if( sortTogether == true ) {
+        changedFiles.append( update.fileName );
+      } else {
+        moveToSortedRow( update.fileName );
+      }
+    }
+  }
+  if( changedFiles.isEmpty() == false ) {
+    sortFiles( changedFiles );
+  }
+  if( newFiles.isEmpty() == true ) {
+    return;
+  }
+
+  QStringList files;
+  files.reserve( newFiles.size() );
+  for( const FileUpdate* update: newFiles ) {
+    d->spellingMistakes.insert( update->fileName, d->createEntry( update->fileName, update->words, update->inStartupProject ) );
+    files.append( update->fileName );
+  }
+  /* Sort the new files and get the row that each must be inserted at in
+   * the current list. The rows are in ascending order, new files with the
+   * same row are inserted together. */
+  std::sort( files.begin(), files.end(), [this]( const QString& lhs, const QString& rhs ) { return d->lessThan( lhs, rhs ); } );
+  QVector<int32_t> sortedRows;
+  sortedRows.reserve( files.size() );
+  for( const QString& file: qAsConst( files ) ) {
+    sortedRows.append( d->sortedRow( file ) );
+  }
+  int32_t inserted = 0;
+  int32_t first    = 0;
+  while( first < files.size() ) {
+    int32_t last = first;
+    while( ( ( last + 1 ) < files.size() )
+           && ( sortedRows.at( last + 1 ) == sortedRows.at( first ) ) ) {
+      ++last;
+    }
+    const int32_t row = sortedRows.at( first ) + inserted;
+    beginInsertRows( QModelIndex(), row, row + ( last - first ) );
+    for( int32_t index = first; index <= last; ++index ) {
+      d->sortedKeys.insert( row + ( index - first ), files.at( index ) );
+    }
+    d->invalidateRows( row );
+    endInsertRows();
+    inserted += ( last - first ) + 1;
+    first     = last + 1;
   }
 }
 // --------------------------------------------------
@@ -116,32 +410,151 @@ void ProjectMistakesModel::clearAllSpellingMistakes()
 {
   beginResetModel();
   d->spellingMistakes.clear();
+  d->wordIndex.clear();
   d->sortedKeys.clear();
+  d->rows.clear();
+  d->rowsValidBefore = 0;
   endResetModel();
+  /* Most of the texts of the mistakes are no longer used. */
+  releaseUnusedTexts();
 }
 // --------------------------------------------------
 
 SpellChecker::WordList ProjectMistakesModel::mistakesForFile( const QString& fileName ) const
 {
-  return d->spellingMistakes.value( fileName ).first;
+  WordList words;
+  const FileMistakes::ConstIterator file = d->spellingMistakes.constFind( fileName );
+  if( file == d->spellingMistakes.constEnd() ) {
+    return words;
+  }
+  words.reserve( file.value().words.size() );
+  for( const Word& word: file.value().words ) {
+    words.append( word );
+  }
+  return words;
+}
+// --------------------------------------------------
+
+bool ProjectMistakesModel::mistakeAt( const QString& fileName, int32_t line, int32_t column, Word& word ) const
+{
+  const FileMistakes::ConstIterator file = d->spellingMistakes.constFind( fileName );
+  if( file == d->spellingMistakes.constEnd() ) {
+    return false;
+  }
+  const QVector<Word>& words        = file.value().words;
+  const QVector<int32_t>& positions = file.value().positions;
+  /* Words do not overlap, the last word that starts before or on the position
+   * is the only word that can contain the position. */
+  Word position;
+  position.lineNumber   = line;
+  position.columnNumber = column;
+  QVector<int32_t>::ConstIterator iter = std::upper_bound( positions.constBegin(), positions.constEnd(), position, [&words]( const Word& lhs, int32_t rhs ) {
+    return positionLessThan( lhs, words.at( rhs ) );
+  } );
+  if( iter == positions.constBegin() ) {
+    return false;
+  }
+  --iter;
+  const Word& found = words.at( *iter );
+  if( ( found.lineNumber != line )
+      || ( ( found.columnNumber + found.length ) < column ) ) {
+    return false;
+  }
+  word = found;
+  return true;
+}
+// --------------------------------------------------
+
+QVector<Word> ProjectMistakesModel::mistakesInLines( const QString& fileName, int32_t firstLine, int32_t lastLine ) const
+{
+  const FileMistakes::ConstIterator file = d->spellingMistakes.constFind( fileName );
+  if( file == d->spellingMistakes.constEnd() ) {
+    return {};
+  }
+  const QVector<Word>& words        = file.value().words;
+  const QVector<int32_t>& positions = file.value().positions;
+  const auto lineLessThan           = [&words]( int32_t index, int32_t line ) { return words.at( index ).lineNumber < line; };
+  const auto first                  = std::lower_bound( positions.constBegin(), positions.constEnd(), firstLine, lineLessThan );
+  const auto last                   = std::lower_bound( first, positions.constEnd(), lastLine + 1, lineLessThan );
+  QVector<Word> wordsInLines;
+  wordsInLines.reserve( int32_t( last - first ) );
+  for( auto iter = first; iter != last; ++iter ) {
+    wordsInLines.append( words.at( *iter ) );
+  }
+  return wordsInLines;
+}
+// --------------------------------------------------
+
+SpellChecker::WordList ProjectMistakesModel::occurrencesInFile( const QString& fileName, const QString& wordText ) const
+{
+  WordList occurrences;
+  const FileMistakes::ConstIterator file = d->spellingMistakes.constFind( fileName );
+  if( file == d->spellingMistakes.constEnd() ) {
+    return occurrences;
+  }
+  const QVector<Word>& words = file.value().words;
+  for( const int32_t index: file.value().occurrences.value( wordText ) ) {
+    occurrences.append( words.at( index ) );
+  }
+  return occurrences;
+}
+// --------------------------------------------------
+
+SpellChecker::FileWordList ProjectMistakesModel::occurrencesInProject( const QString& wordText ) const
+{
+  FileWordList occurrences;
+  const QHash<QString, WordFiles>::ConstIterator indexIter = d->wordIndex.constFind( wordText );
+  if( indexIter == d->wordIndex.constEnd() ) {
+    return occurrences;
+  }
+  const WordFiles::ConstIterator filesEnd = indexIter.value().constEnd();
+  for( WordFiles::ConstIterator fileIter = indexIter.value().constBegin(); fileIter != filesEnd; ++fileIter ) {
+    occurrences.insert( fileIter.key(), occurrencesInFile( fileIter.key(), wordText ) );
+  }
+  return occurrences;
+}
+// --------------------------------------------------
+
+int32_t ProjectMistakesModel::occurrenceCountInProject( const QString& wordText ) const
+{
+  const WordFiles files = d->wordIndex.value( wordText );
+  return std::accumulate( files.constBegin(), files.constEnd(), int32_t( 0 ) );
 }
 // --------------------------------------------------
 
 void ProjectMistakesModel::removeAllOccurrences( const QString& wordText )
 {
-  beginResetModel();
-  FileMistakes::Iterator iter = d->spellingMistakes.begin();
-  while( iter != d->spellingMistakes.end() ) {
-    iter.value().first.remove( wordText );
+  /* Only the files that contain the word are updated. */
+  const QHash<QString, WordFiles>::iterator indexIter = d->wordIndex.find( wordText );
+  if( indexIter == d->wordIndex.end() ) {
+    return;
+  }
+  const QStringList files = indexIter.value().keys();
+  d->wordIndex.erase( indexIter );
+  for( const QString& fileName: files ) {
+    FileMistakes::Iterator file = d->spellingMistakes.find( fileName );
+    if( file == d->spellingMistakes.end() ) {
+      continue;
+    }
+    file.value().words.removeIf( [&wordText]( const Word& word ) { return word.text == wordText; } );
     /* If there are no more words for the file, remove the file from the list */
-    if( iter.value().first.isEmpty() == true ) {
-      d->sortedKeys.removeAll( iter.key() );
-      iter = d->spellingMistakes.erase( iter );
+    if( file.value().words.isEmpty() == true ) {
+      const int32_t row = indexOfFile( fileName );
+      Q_ASSERT( row != -1 );
+      beginRemoveRows( QModelIndex(), row, row );
+      d->spellingMistakes.erase( file );
+      d->sortedKeys.removeAt( row );
+      d->rows.remove( fileName );
+      d->invalidateRows( row );
+      endRemoveRows();
     } else {
-      ++iter;
+      d->updateCachedValues( file.value() );
+      /* The counts changed, the file might have to move. */
+      moveToSortedRow( fileName );
     }
   }
-  endResetModel();
+  /* The text of the word is no longer used by the mistakes. */
+  releaseUnusedTexts();
 }
 // --------------------------------------------------
 
@@ -165,10 +578,8 @@ void ProjectMistakesModel::projectFilesChanged( QStringSet filesAdded, QStringSe
       auto wordIter = d->spellingMistakes.find( *addedIter );
       if( wordIter != mistakesEnd ) {
         /* Found one */
-        wordIter.value().second = true;
-        const int32_t row       = indexOfFile( *addedIter );
-        const QModelIndex idx   = index( row, COLUMN_FILE_IN_STARTUP );
-        emit dataChanged( idx, idx );
+        wordIter.value().inStartupProject = true;
+        moveToSortedRow( *addedIter );
       }
     }
   }
@@ -179,10 +590,8 @@ void ProjectMistakesModel::projectFilesChanged( QStringSet filesAdded, QStringSe
       auto wordIter = d->spellingMistakes.find( *removedIter );
       if( wordIter != mistakesEnd ) {
         /* Found one */
-        wordIter.value().second = false;
-        const int32_t row       = indexOfFile( *removedIter );
-        const QModelIndex idx   = index( row, COLUMN_FILE_IN_STARTUP );
-        emit dataChanged( idx, idx );
+        wordIter.value().inStartupProject = false;
+        moveToSortedRow( *removedIter );
       }
     }
   }
@@ -196,17 +605,13 @@ void ProjectMistakesModel::fileSelected( const QModelIndex& index )
     Core::IEditor* editor = Core::EditorManager::openEditor( Utils::FilePath::fromString(fileName) );
     emit editorOpened();
     Q_ASSERT( editor != nullptr );
-    Q_ASSERT( d->spellingMistakes.value( fileName ).first.isEmpty() == false );
     /* Go to the first misspelled word in the editor. */
-    const SpellChecker::WordList words = d->spellingMistakes.value( fileName ).first;
-    Q_ASSERT( words.empty() == false );
-    /* Get a word on the first line with a spelling mistake and
-     * go to that line. This is to ensure that the highest up spelling
-     * mistake is selected instead of a random mistake randomly in the
-     * file. This seemed strange. */
-    const Word word = *std::min_element( words.begin(), words.end(), []( const Word& lhs, const Word& rhs ) {
-      return lhs.lineNumber < rhs.lineNumber;
-    } );
+    const FileMistakesEntry entry = d->spellingMistakes.value( fileName );
+    Q_ASSERT( entry.positions.isEmpty() == false );
+    /* Go to the highest up spelling mistake instead of a random mistake
+     * randomly in the file. This seemed strange. The positions are sorted
+     * thus this is the first one. */
+    const Word word = entry.words.at( entry.positions.first() );
     editor->gotoLine( int32_t( word.lineNumber ), int32_t( word.columnNumber - 1 ) );
   }
 }
@@ -234,7 +639,7 @@ int ProjectMistakesModel::rowCount( const QModelIndex& parent ) const
   if( parent.isValid() == true ) {
     return 0;
   } else {
-    return d->spellingMistakes.count();
+    return int( d->sortedKeys.count() );
   }
 }
 // --------------------------------------------------
@@ -267,17 +672,17 @@ QVariant ProjectMistakesModel::data( const QModelIndex& index, int role ) const
 
   switch( role ) {
     case COLUMN_FILE:
-      return QFileInfo( iter.key() ).fileName();
+      return iter.value().name;
     case COLUMN_MISTAKES_TOTAL:
-      return ( iter.value().first.count() );
+      return ( iter.value().words.count() );
     case COLUMN_FILEPATH:
       return iter.key();
     case COLUMN_FILE_IN_STARTUP:
-      return ( iter.value().second );
+      return ( iter.value().inStartupProject );
     case COLUMN_LITERAL_COUNT:
-      return countStringLiterals( iter.value().first );
+      return iter.value().literalCount;
     case COLUMN_FILE_TYPE:
-      return QFileInfo( iter.key() ).suffix();
+      return iter.value().suffix;
     default:
       return QVariant();
   }
@@ -286,7 +691,64 @@ QVariant ProjectMistakesModel::data( const QModelIndex& index, int role ) const
 
 int ProjectMistakesModel::indexOfFile( const QString& fileName ) const
 {
-  return d->sortedKeys.indexOf( fileName );
+  return d->rowOf( fileName );
+}
+// --------------------------------------------------
+
+void ProjectMistakesModel::moveToSortedRow( const QString& fileName )
+{
+  const int32_t row = indexOfFile( fileName );
+  Q_ASSERT( row != -1 );
+  /* Find the sorted row without the file in the list. */
+  d->sortedKeys.removeAt( row );
+  const int32_t sortedRow = d->sortedRow( fileName );
+  d->sortedKeys.insert( row, fileName );
+  if( sortedRow != row ) {
+    /* The destination of beginMoveRows() is the row before the move, which
+     * is one more than the sorted row if the file moves down. */
+    const int32_t destination = ( sortedRow > row ) ? ( sortedRow + 1 ) : sortedRow;
+    beginMoveRows( QModelIndex(), row, row, QModelIndex(), destination );
+    d->sortedKeys.move( row, sortedRow );
+    d->invalidateRows( std::min( row, sortedRow ) );
+    endMoveRows();
+  }
+  emit dataChanged( index( sortedRow, 0, QModelIndex() ), index( sortedRow, columnCount( QModelIndex() ) - 1, QModelIndex() ) );
+}
+// --------------------------------------------------
+
+void ProjectMistakesModel::sortFiles( const QStringList& fileNames )
+{
+  emit layoutAboutToBeChanged( {}, QAbstractItemModel::VerticalSortHint );
+  const QModelIndexList oldIndexes = persistentIndexList();
+  QStringList oldFiles;
+  oldFiles.reserve( oldIndexes.size() );
+  for( const QModelIndex& oldIndex: oldIndexes ) {
+    oldFiles.append( d->sortedKeys.at( oldIndex.row() ) );
+  }
+  /* The files that did not change are still sorted, the changed files are
+   * sorted on their own and merged with them. */
+  const QSet<QString> changed( fileNames.constBegin(), fileNames.constEnd() );
+  QList<QString> unchanged;
+  unchanged.reserve( d->sortedKeys.size() );
+  for( const QString& fileName: qAsConst( d->sortedKeys ) ) {
+    if( changed.contains( fileName ) == false ) {
+      unchanged.append( fileName );
+    }
+  }
+  QStringList sortedFiles( changed.constBegin(), changed.constEnd() );
+  const auto lessThan = [this]( const QString& lhs, const QString& rhs ) { return d->lessThan( lhs, rhs ); };
+  std::sort( sortedFiles.begin(), sortedFiles.end(), lessThan );
+  d->sortedKeys.clear();
+  d->sortedKeys.reserve( unchanged.size() + sortedFiles.size() );
+  std::merge( unchanged.constBegin(), unchanged.constEnd(), sortedFiles.constBegin(), sortedFiles.constEnd(), std::back_inserter( d->sortedKeys ), lessThan );
+  d->rowsValidBefore = 0;
+  QModelIndexList newIndexes;
+  newIndexes.reserve( oldIndexes.size() );
+  for( int32_t item = 0; item < oldIndexes.size(); ++item ) {
+    newIndexes.append( index( indexOfFile( oldFiles.at( item ) ), oldIndexes.at( item ).column(), QModelIndex() ) );
+  }
+  changePersistentIndexList( oldIndexes, newIndexes );
+  emit layoutChanged( {}, QAbstractItemModel::VerticalSortHint );
 }
 // --------------------------------------------------
 
@@ -295,63 +757,8 @@ void ProjectMistakesModel::sort( int column, Qt::SortOrder order )
   beginResetModel();
   d->sortedColumn = static_cast<Columns>( column );
   d->sortOrder    = order;
-  std::sort( d->sortedKeys.begin(), d->sortedKeys.end(), [=, this]( const QString& stringLhs, const QString& strinRhs ) -> bool {
-    FileMistakes::ConstIterator iterLhs = d->spellingMistakes.find( stringLhs );
-    FileMistakes::ConstIterator iterRhs = d->spellingMistakes.find( strinRhs );
-    if( ( iterLhs == d->spellingMistakes.constEnd() )
-        || ( iterRhs == d->spellingMistakes.constEnd() ) ) {
-      /* This should not be possible */
-      Q_ASSERT( false );
-      return false;
-    }
-
-    /* Check to see if both files are internal or external to the current project.
-     * If the LHS is internal and RHS not, the internal one is always greater than
-     * the external one. If they are both either internal or external, then sort
-     * them on the requested column.
-     * This ensures that the files are grouped together based on internal or external
-     * and then sorted according to name. The external files will always be listed last. */
-    if( iterLhs.value().second != iterRhs.value().second ) {
-      return iterLhs.value().second;
-    }
-    bool greaterThan = false;
-
-    switch( d->sortedColumn ) {
-      case SpellChecker::Internal::ProjectMistakesModel::COLUMN_COUNT:
-        break;
-      case COLUMN_FILE:
-        greaterThan = ( QFileInfo( iterLhs.key() ).fileName().toUpper() < QFileInfo( iterRhs.key() ).fileName().toUpper() );
-        break;
-      case COLUMN_MISTAKES_TOTAL:
-        greaterThan = ( iterLhs.value().first.count() < iterRhs.value().first.count() );
-        break;
-      case COLUMN_FILEPATH:
-        greaterThan = ( iterLhs.key().toUpper() < iterRhs.key().toUpper() );
-        break;
-      case COLUMN_FILE_IN_STARTUP:
-        greaterThan = iterLhs.value().second;
-        break;
-      case COLUMN_LITERAL_COUNT: {
-        int countLhs = countStringLiterals( iterLhs.value().first );
-        int countRhs = countStringLiterals( iterRhs.value().first );
-        greaterThan  = ( countLhs < countRhs );
-        break;
-      }
-      case COLUMN_FILE_TYPE: {
-        const QFileInfo infoRhs = QFileInfo( iterRhs.key() );
-        const QFileInfo infoLhs = QFileInfo( iterLhs.key() );
-        if( infoRhs.suffix().toUpper() == infoLhs.suffix().toUpper() ) {
-          greaterThan = ( QFileInfo( iterLhs.key() ).fileName().toUpper() < QFileInfo( iterRhs.key() ).fileName().toUpper() );
-        } else {
-          greaterThan = ( infoLhs.suffix().toUpper() < infoRhs.suffix().toUpper() );
-        }
-        break;
-      }
-    }
-    return ( order == Qt::AscendingOrder )
-    ? greaterThan
-    : !greaterThan;
-  } );
+  std::sort( d->sortedKeys.begin(), d->sortedKeys.end(), [this]( const QString& lhs, const QString& rhs ) { return d->lessThan( lhs, rhs ); } );
+  d->rowsValidBefore = 0;
   endResetModel();
 }
 // --------------------------------------------------
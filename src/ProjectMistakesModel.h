@@ -37,6 +37,14 @@ class ProjectMistakesModel
 {
   Q_OBJECT
 public:
+  /*! \brief Mistakes of a file that must be inserted into the model. */
+  struct FileUpdate
+  {
+    QString fileName;      /*!< Name of the file that the words belong to. */
+    WordList words;        /*!< Misspelled words for the file. */
+    bool inStartupProject; /*!< If the file is part of the startup project, or external. */
+  };
+
   enum Columns {
     COLUMN_FILE = Qt::UserRole,
     COLUMN_MISTAKES_TOTAL,
@@ -69,6 +77,13 @@ public:
    * \param[in] words Misspelled words for the file.
    * \param[in] inStartupProject If the file is part of the startup project, or external. */
   void insertSpellingMistakes( const QString& fileName, const WordList& words, bool inStartupProject );
+  /*! \brief Insert the Spelling Mistakes of multiple files.
+   *
+   * Files that are new to the model and end up next to each other are
+   * inserted using one row insert.
+   * \param[in] updates Mistakes of the files, each file may only be in the
+   *              list once. */
+  void insertSpellingMistakes( const QList<FileUpdate>& updates );
   /*! \brief Clears all Spelling Mistakes added to the model.
    *
    * This would normally be done when the startup project gets changed.
@@ -82,11 +97,42 @@ public:
    * \return A list of misspelled words for the file.
    */
   WordList mistakesForFile( const QString& fileName ) const;
+  /*! \brief Get the mistake at a position in a file.
+   *
+   * The mistakes of each file are indexed on their position, the lookup is
+   * a binary search and does not depend on the number of mistakes in the file.
+   * \param[in] fileName Name of the file.
+   * \param[in] line Line of the position, 1 based.
+   * \param[in] column Column of the position, 1 based. A position directly
+   *              after the word is also regarded as part of the word.
+   * \param[out] word The mistake at the position, if there is one.
+   * \return true if there is a mistake at the position. */
+  bool mistakeAt( const QString& fileName, int32_t line, int32_t column, Word& word ) const;
+  /*! \brief Get the mistakes on the lines \a firstLine to \a lastLine of a file.
+   * \return The mistakes sorted on their position. */
+  QVector<Word> mistakesInLines( const QString& fileName, int32_t firstLine, int32_t lastLine ) const;
+  /*! \brief Get all mistakes in a file with the given text.
+   * \param[in] fileName Name of the file.
+   * \param[in] wordText Text of the mistake.
+   * \return All occurrences of the mistake in the file. */
+  WordList occurrencesInFile( const QString& fileName, const QString& wordText ) const;
+  /*! \brief Get all mistakes in the project with the given text.
+   *
+   * Uses the index of the files that contain each word, only the files that
+   * contain the word are visited.
+   * \param[in] wordText Text of the mistake.
+   * \return The occurrences of the mistake for each file that contains it. */
+  FileWordList occurrencesInProject( const QString& wordText ) const;
+  /*! \brief Get the number of mistakes in the project with the given text. */
+  int32_t occurrenceCountInProject( const QString& wordText ) const;
   /*! \brief Remove all occurrences of the word.
    *
    * This function is used to remove all occurrences of the given word from
    * the model. This will happen when a word is either ignored or added to
    * improve the speed over re-parsing all files in the project.
+   *
+   * The model keeps an index of the files that contain each word, only the
+   * rows of those files are updated or removed.
    * \param[in] wordText Word that must be removed.
    */
   void removeAllOccurrences( const QString& wordText );
@@ -107,6 +153,17 @@ signals:
   /*! \brief Signal that will be emitted if the fileSelected() slot opens a editor. */
   void editorOpened();
 private:
+  /*! \brief Move the file to the row that keeps the files sorted.
+   *
+   * Called when a value of the file that it could be sorted on changed. */
+  void moveToSortedRow( const QString& fileName );
+  /*! \brief Move the files to the rows that keep the files sorted with one
+   * layout change.
+   *
+   * Used for the files of a large batch that changed. All files except for
+   * \a fileNames must be sorted. */
+  void sortFiles( const QStringList& fileNames );
+
   ProjectMistakesModelPrivate* const d;
 };
 // --------------------------------------------------
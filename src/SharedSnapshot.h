@@ -0,0 +1,119 @@
+/**************************************************************************
+**
+** Copyright (c) 2014 Carel Combrink
+**
+** This file is part of the SpellChecker Plugin, a Qt Creator plugin.
+**
+** The SpellChecker Plugin is free software: you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public License as
+** published by the Free Software Foundation, either version 3 of the
+** License, or (at your option) any later version.
+**
+** The SpellChecker Plugin is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with the SpellChecker Plugin.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#pragma once
+
+#include <QMutex>
+#include <QtGlobal>
+
+#include <atomic>
+#include <memory>
+#include <version>
+
+namespace SpellChecker {
+
+/*! \brief The SharedSnapshot class
+ *
+ * Holds the latest immutable snapshot of a value that is shared between the
+ * GUI thread and the worker threads. Each published snapshot gets a generation
+ * number that only increases, a worker keeps the snapshot that it loaded for
+ * its whole job and caches can use the generation to know if they were
+ * created with the latest value.
+ *
+ * Loading a snapshot does not copy the value, it only takes a reference to the
+ * snapshot. Publishing a new value swaps the pointer, snapshots that are still
+ * held by workers stay valid until the last of them is released.
+ *
+ * If the standard library supports atomic shared pointers they are used,
+ * otherwise the pointer is guarded by a mutex that is only held for the swap.
+ * New values must be published from one thread at a time, normally the GUI
+ * thread, so that the generations are published in order. */
+template<typename T>
+class SharedSnapshot
+{
+  SharedSnapshot( const SharedSnapshot& )            = delete;
+  SharedSnapshot& operator=( const SharedSnapshot& ) = delete;
+public:
+  /*! \brief Immutable value along with its generation. */
+  class Snapshot
+  {
+  public:
+    Snapshot( T value, quint64 generation )
+      : d_value( std::move( value ) )
+      , d_generation( generation )
+    {}
+    /*! \brief The value of the snapshot. */
+    const T& value() const { return d_value; }
+    /*! \brief Generation of the snapshot. */
+    quint64 generation() const { return d_generation; }
+  private:
+    const T d_value;
+    const quint64 d_generation;
+  };
+  using Ptr = std::shared_ptr<const Snapshot>;
+
+  /*! \brief Constructor, the initial \a value gets generation 1. */
+  explicit SharedSnapshot( T value = T() )
+    : d_snapshot( std::make_shared<const Snapshot>( std::move( value ), 1 ) )
+  {}
+  /*! \brief Get the latest snapshot. */
+  Ptr load() const
+  {
+#if defined( __cpp_lib_atomic_shared_ptr )
+    return d_snapshot.load( std::memory_order_acquire );
+#else
+    QMutexLocker locker( &d_mutex );
+    return d_snapshot;
+#endif
+  }
+  /*! \brief Get the generation of the latest snapshot. */
+  quint64 generation() const
+  {
+    return d_generation.load( std::memory_order_acquire );
+  }
+  /*! \brief Publish a new \a value with the next generation.
+   * \return The snapshot that was published. */
+  Ptr publish( T value )
+  {
+    const quint64 generation = d_generation.load( std::memory_order_relaxed ) + 1;
+    Ptr snapshot             = std::make_shared<const Snapshot>( std::move( value ), generation );
+#if defined( __cpp_lib_atomic_shared_ptr )
+    d_snapshot.store( snapshot, std::memory_order_release );
+#else
+    {
+      QMutexLocker locker( &d_mutex );
+      d_snapshot = snapshot;
+    }
+#endif
+    d_generation.store( generation, std::memory_order_release );
+    return snapshot;
+  }
+
+private:
+#if defined( __cpp_lib_atomic_shared_ptr )
+  std::atomic<Ptr> d_snapshot;
+#else
+  mutable QMutex d_mutex;
+  Ptr d_snapshot;
+#endif
+  std::atomic<quint64> d_generation{ 1 };
+};
+
+} // namespace SpellChecker
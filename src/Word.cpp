@@ -0,0 +1,148 @@
+/**************************************************************************
+**
+** Copyright (c) 2014 Carel Combrink
+**
+** This file is part of the SpellChecker Plugin, a Qt Creator plugin.
+**
+** The SpellChecker Plugin is free software: you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public License as
+** published by the Free Software Foundation, either version 3 of the
+** License, or (at your option) any later version.
+**
+** The SpellChecker Plugin is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Lesser General Public License for more details.
+**
+** You should have received a copy of the GNU Lesser General Public License
+** along with the SpellChecker Plugin.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+
+#include "Word.h"
+
+#include <QReadWriteLock>
+#include <QSet>
+
+#include <algorithm>
+#include <numeric>
+
+namespace {
+/*! \brief Pool of the interned texts. */
+class TextPool
+{
+public:
+  QReadWriteLock lock;
+  QSet<QString> texts;
+};
+
+TextPool& pool()
+{
+  static TextPool textPool;
+  return textPool;
+}
+} // namespace
+
+QString SpellChecker::internText( const QString& text )
+{
+  TextPool& textPool = pool();
+  {
+    QReadLocker locker( &textPool.lock );
+    const QSet<QString>::ConstIterator iter = textPool.texts.constFind( text );
+    if( iter != textPool.texts.constEnd() ) {
+      return *iter;
+    }
+  }
+  QWriteLocker locker( &textPool.lock );
+  return *textPool.texts.insert( text );
+}
+// --------------------------------------------------
+
+void SpellChecker::releaseUnusedTexts()
+{
+  TextPool& textPool = pool();
+  QWriteLocker locker( &textPool.lock );
+  /* New references to the texts are only handed out while the lock is held,
+   * a text that is detached is not used outside of the pool. */
+  QSet<QString>::Iterator iter = textPool.texts.begin();
+  while( iter != textPool.texts.end() ) {
+    if( iter->isDetached() == true ) {
+      iter = textPool.texts.erase( iter );
+    } else {
+      ++iter;
+    }
+  }
+}
+// --------------------------------------------------
+
+std::pair<QVector<int32_t>::const_iterator, QVector<int32_t>::const_iterator> SpellChecker::FlatWordList::indexRange( const QString& text ) const
+{
+  const int32_t wordCount = int32_t( d_words.size() );
+  if( d_indexed < wordCount ) {
+    /* Only sort the words appended since the last lookup and merge them into
+     * the index, the words already indexed did not change. */
+    const auto lessThan = [this]( int32_t lhs, int32_t rhs ) {
+      const int32_t compare = d_words.at( lhs ).text.compare( d_words.at( rhs ).text );
+      return ( compare != 0 ) ? ( compare < 0 ) : ( lhs < rhs );
+    };
+    d_index.resize( wordCount );
+    const QVector<int32_t>::iterator tail = d_index.begin() + d_indexed;
+    std::iota( tail, d_index.end(), d_indexed );
+    std::sort( tail, d_index.end(), lessThan );
+    std::inplace_merge( d_index.begin(), tail, d_index.end(), lessThan );
+    d_indexed = wordCount;
+  }
+  struct Compare
+  {
+    const QVector<Word>& words;
+    bool operator()( int32_t index, const QString& text ) const { return words.at( index ).text < text; }
+    bool operator()( const QString& text, int32_t index ) const { return text < words.at( index ).text; }
+  };
+  return std::equal_range( d_index.constBegin(), d_index.constEnd(), text, Compare{ d_words } );
+}
+// --------------------------------------------------
+
+SpellChecker::FlatWordList::const_iterator SpellChecker::FlatWordList::constFind( const QString& text ) const
+{
+  const auto range = indexRange( text );
+  if( range.first == range.second ) {
+    return d_words.constEnd();
+  }
+  return d_words.constBegin() + *range.first;
+}
+// --------------------------------------------------
+
+bool SpellChecker::FlatWordList::contains( const QString& text ) const
+{
+  const auto range = indexRange( text );
+  return ( range.first != range.second );
+}
+// --------------------------------------------------
+
+int32_t SpellChecker::FlatWordList::remove( const QString& text )
+{
+  if( contains( text ) == false ) {
+    /* Prevent a detach if there is nothing to remove. */
+    return 0;
+  }
+  const iterator newEnd = std::remove_if( d_words.begin(), d_words.end(), [&text]( const Word& word ) {
+    return word.text == text;
+  } );
+  const int32_t removed = int32_t( d_words.end() - newEnd );
+  d_words.erase( newEnd, d_words.end() );
+  dropIndex();
+  return removed;
+}
+// --------------------------------------------------
+
+QList<SpellChecker::Word> SpellChecker::FlatWordList::values( const QString& text ) const
+{
+  QList<Word> words;
+  const auto range = indexRange( text );
+  words.reserve( int32_t( range.second - range.first ) );
+  for( auto iter = range.first; iter != range.second; ++iter ) {
+    words.append( d_words.at( *iter ) );
+  }
+  return words;
+}
+// --------------------------------------------------
@@ -20,10 +20,15 @@
 
 #pragma once
 
+#include "FileTable.h"
+
 #include <QDebug>
 #include <QMultiHash>
 #include <QString>
 #include <QStringList>
+#include <QVector>
+
+#include <utility>
 
 namespace SpellChecker {
 
@@ -38,6 +43,17 @@ using QStringSet = QSet<QString>;
  * This class is a structure representing a word parsed from the source. It
  * contains information about the word, where it is located and suggestions
  * for the word if it was misspelled.
+ *
+ * Large numbers of words are kept for the mistakes of a project, the layout
+ * is kept compact for this reason:
+ *  - The file is stored as a FileId into the FileTable instead of a copy
+ *    of the name of the file.
+ *  - The text of mistakes is interned using internText(), all mistakes with
+ *    the same text share the same string data.
+ *  - The suggestions are implicitly shared between all occurrences of a
+ *    mistake.
+ *  - The end of the word is not stored, it is computed from the start and
+ *    the length.
  */
 class Word
 {
@@ -45,41 +61,65 @@ public:
   Word() = default;
   ~Word() = default;
 
-  int32_t start;
-  int32_t end;
-  int32_t length;
-
-  int32_t lineNumber;
-  int32_t columnNumber;
   QString text;
-  QString fileName;
-  QChar charAfter; /*!< Next character after the end of the word in the comment. */
-  bool  inComment; /*!< If the word comes from a comment or a String Literal. */
   QStringList suggestions;
+  FileId fileId        = cINVALID_FILE_ID;
+  int32_t lineNumber   = 0;
+  int32_t columnNumber = 0;
+  int32_t start        = 0;
+  int32_t length       = 0;
+  QChar charAfter;        /*!< Next character after the end of the word in the comment. */
+  bool  inComment = false; /*!< If the word comes from a comment or a String Literal. */
+  bool  checked   = false; /*!< The word is a mistake that was checked before, the spell
+                            * checker does not have to check it again and the suggestions
+                            * are already set. */
+
+  /*! \brief Position after the end of the word. */
+  int32_t end() const
+  {
+    return start + length;
+  }
+  /*! \brief Name of the file that the word is in. */
+  QString fileName() const
+  {
+    return FileTable::fileName( fileId );
+  }
 
   bool operator==( const Word& other ) const
   {
     return ( ( lineNumber == other.lineNumber )
              && ( columnNumber == other.columnNumber )
              && ( text == other.text )
-             && ( fileName == other.fileName ) );
+             && ( fileId == other.fileId ) );
   }
 };
+/* The size of a word is a large part of the memory used for the mistakes of
+ * a project, make sure that it does not grow unnoticed. The positions and
+ * flags are not packed into bit fields, the text and the suggestions take up
+ * most of the word and the flags already fit in the padding after charAfter. */
+static_assert( ( sizeof( void* ) != 8 ) || ( sizeof( Word ) <= 72 ), "Word must stay compact" );
 
-/* Define used to use different types of word lists
- * for the spell checker. The 2 different types were defined
- * to test usage as well speed/performance of different
- * implementations. This was not done yet but might still be
- * done in future. */
-#define USE_MULTI_HASH
-#ifdef USE_MULTI_HASH
-class WordList
+/*! \brief Get the interned version of the \a text.
+ *
+ * All calls with equal texts return a string that shares the same data. This
+ * is used for the text of mistakes that are kept for the whole project. The
+ * interned texts are kept until releaseUnusedTexts() finds that they are no
+ * longer used. Thread safe. */
+QString internText( const QString& text );
+/*! \brief Release the interned texts that are only referenced by the pool.
+ *
+ * Called by the owner of the mistakes when a large part of them was dropped.
+ * Thread safe. */
+void releaseUnusedTexts();
+
+/*! \brief Word list that keeps the words in a QMultiHash on their text. */
+class HashWordList
   : public QMultiHash<QString, Word>
 {
 public:
-  inline WordList() = default;
+  inline HashWordList() = default;
   void append( const Word& t ) { this->insert( t.text, t ); }
-  void append( const WordList& l )
+  void append( const HashWordList& l )
   {
     for( const Word& t: l ) {
       append( t );
@@ -87,12 +127,115 @@ public:
   }
 };
 
-typedef WordList::iterator WordListIter;
-typedef WordList::const_iterator WordListConstIter;
+/*! \brief The FlatWordList class
+ *
+ * Flat list of words. The words are stored contiguously in the order that
+ * they were appended, for the parsers this is the order of the words in the
+ * source. Iterating the list does not chase pointers and appending a word
+ * does not allocate a node for the word.
+ *
+ * Lookups on the text of the words use an index of the words sorted on their
+ * text, each text maps to a range in the index. The index is built on the
+ * first lookup, lists that are only built and iterated never pay for it.
+ * Appended words are merged into the index on the next lookup, only changes
+ * to the words already in the list drop the index. Since the index is built by the const lookup
+ * functions, the same list must not be looked up from different threads at
+ * the same time, copies of a list are independent. */
+class FlatWordList
+{
+public:
+  using iterator       = QVector<Word>::iterator;
+  using const_iterator = QVector<Word>::const_iterator;
+  using Iterator       = iterator;
+  using ConstIterator  = const_iterator;
+
+  FlatWordList() = default;
+
+  void append( const Word& word ) { d_words.append( word ); }
+  void append( const FlatWordList& words ) { d_words.append( words.d_words ); }
+  void reserve( int32_t size ) { d_words.reserve( size ); }
+  int32_t count() const { return int32_t( d_words.count() ); }
+  int32_t size() const { return int32_t( d_words.size() ); }
+  bool isEmpty() const { return d_words.isEmpty(); }
+  void clear()
+  {
+    d_words.clear();
+    dropIndex();
+  }
+
+  /* Words might be changed through the non const iterators, the index is
+   * dropped when one is requested. */
+  iterator begin()
+  {
+    dropIndex();
+    return d_words.begin();
+  }
+  iterator end()
+  {
+    dropIndex();
+    return d_words.end();
+  }
+  const_iterator begin() const { return d_words.constBegin(); }
+  const_iterator end() const { return d_words.constEnd(); }
+  const_iterator constBegin() const { return d_words.constBegin(); }
+  const_iterator constEnd() const { return d_words.constEnd(); }
+  /*! \brief Remove the word at \a pos and return an iterator to the next word. */
+  iterator erase( const_iterator pos )
+  {
+    dropIndex();
+    return d_words.erase( pos );
+  }
+
+  /*! \brief Find the first word with the given \a text.
+   * \return Iterator to the word or constEnd() if there is no such word. */
+  const_iterator constFind( const QString& text ) const;
+  /*! \brief Check if the list contains a word with the given \a text. */
+  bool contains( const QString& text ) const;
+  /*! \brief Remove all words with the given \a text.
+   * \return Number of words removed. */
+  int32_t remove( const QString& text );
+  /*! \brief Get all the words in the list. */
+  QList<Word> values() const { return d_words; }
+  /*! \brief Get all the words with the given \a text in the order of the list. */
+  QList<Word> values( const QString& text ) const;
+
+private:
+  void dropIndex()
+  {
+    d_index.clear();
+    d_indexed = 0;
+  }
+  /*! \brief Range in the index of the words with the given \a text. */
+  std::pair<QVector<int32_t>::const_iterator, QVector<int32_t>::const_iterator> indexRange( const QString& text ) const;
+
+  QVector<Word> d_words;
+  /* Indexes into d_words sorted on the text of the words, and on the
+   * position in d_words for equal texts. Only covers the first d_indexed
+   * words, the words appended after them are merged in on the next lookup. */
+  mutable QVector<int32_t> d_index;
+  mutable int32_t d_indexed = 0;
+};
+
+/* Define used to select the type of word list used by the spell checker.
+ *
+ * By default the words are kept in a HashWordList. Configure with
+ * SPELLCHECKER_FLAT_WORDLIST to keep the words in a FlatWordList instead.
+ * Both implementations provide the same interface and are compiled in every
+ * configuration, they can be compared using the BENCH_TIME output of the
+ * parsers, the spell checker and the publishing of the results. The flat list
+ * stays opt-in until it has been measured to be faster on real projects. */
+#ifndef SPELLCHECKER_FLAT_WORDLIST
+#define USE_MULTI_HASH
+#endif /* SPELLCHECKER_FLAT_WORDLIST */
+#ifdef USE_MULTI_HASH
+using WordList = HashWordList;
 #else /* USE_MULTI_HASH */
-typedef QList<Word> WordList;
+using WordList = FlatWordList;
 #endif /* USE_MULTI_HASH */
 
+typedef WordList::iterator WordListIter;
+typedef WordList::const_iterator WordListConstIter;
+
 typedef QHash<QString /* File name */, WordList> FileWordList;
 
 /*! \brief Class containing the words of a specific token.
@@ -101,28 +244,47 @@ typedef QHash<QString /* File name */, WordList> FileWordList;
  * start position (line and column) of the token. The line and column is used
  * for keeping the offset correct if a token moved due to new tokens or text.
  * This is then used to adjust the line and column numbers of the words to the
- * correct locations. */
+ * correct locations.
+ *
+ * Once the words of the token were spell checked, the mistakes among them are
+ * kept along with the generation of the dictionary that they were checked
+ * with. While the generation is current, the words of the token do not have
+ * to be checked again.
+ *
+ * The words can also be kept as they were extracted, before the settings of the
+ * parser were applied to them, so that only the settings have to be applied
+ * again if they change. */
 class TokenWords
 {
 public:
   int32_t line;
   int32_t col;
   WordList words;
+  int32_t length;     /*!< Length of the token, used to verify that a matching hash is the same token. */
+  WordList mistakes;  /*!< The words of the token that are spelling mistakes. */
+  quint64 generation; /*!< Generation of the dictionary of the \a mistakes, 0 if not checked. */
+  WordList rawWords;  /*!< The words as they were extracted, if they are kept. */
+  bool filtered;      /*!< If the \a words are the \a rawWords with the current settings applied. */
 
-  TokenWords( int32_t l = 0, int32_t c = 0, const WordList& w = WordList() )
+  TokenWords( int32_t l = 0, int32_t c = 0, const WordList& w = WordList(), int32_t len = 0, const WordList& m = WordList(), quint64 g = 0, const WordList& r = WordList() )
     : line( l )
     , col( c )
-    , words( w ) {}
+    , words( w )
+    , length( len )
+    , mistakes( m )
+    , generation( g )
+    , rawWords( r )
+    , filtered( true ) {}
 };
 /*! \brief Hash of a token and the corresponding list of words that were extracted from the token.
  *
- * The quint32 is result of the qHash(QString, 0) and stored in the hash for each token, along with
- * the list of words that were extracted from that comment. The hash of the token is used instead of
- * the string because there is no need for the extra memory in the hash to store the actual token.
+ * The quint64 is a 64 bit hash of the bytes of the token and stored in the hash for each token, along
+ * with the list of words that were extracted from that comment. The hash of the token is used instead
+ * of the string because there is no need for the extra memory in the hash to store the actual token.
  * If the hash was defined as QHash<QString, CommentWords> the hash would store the full token in
  * memory so that it can be obtained using the QHash::key() function. Some token can be long and the
- * overhead is not needed. */
-using HashWords = QHash<quint32, TokenWords>;
+ * overhead is not needed. The length of the token is stored to detect most collisions of the hash. */
+using HashWords = QHash<quint64, TokenWords>;
 
 } // namespace SpellChecker
 
@@ -115,13 +115,12 @@ void IDocumentParser::getWordsFromSplitString( const QStringList& stringList, co
   for( int wordIdx = 0; wordIdx < numbSplitWords; ++wordIdx ) {
     Word newWord;
     newWord.text         = stringList.at( wordIdx );
-    newWord.fileName     = word.fileName;
+    newWord.fileId       = word.fileId;
     currentPos           = ( word.text ).indexOf( newWord.text, currentPos );
     newWord.columnNumber = word.columnNumber + currentPos;
     newWord.lineNumber   = word.lineNumber;
     newWord.length       = newWord.text.length();
     newWord.start        = word.start + currentPos;
-    newWord.end          = newWord.start + newWord.length;
     newWord.inComment    = word.inComment;
     currentPos           = currentPos + newWord.length;
     /* Add the word to the end of the word list so that it can be checked against the
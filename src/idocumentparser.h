@@ -56,7 +56,41 @@ public:
   static void removeWordsThatAppearInSource( const QStringSet& wordsInSource, WordList& words );
 protected:
 signals:
-  void spellcheckWordsParsed( const QString& fileName, const SpellChecker::WordList& wordlist );
+  /*! \brief Signal emitted when all words of a file were parsed.
+   *
+   * This is the commit for the file, \a wordlist must contain all words
+   * of the file that should be checked, including words that were already
+   * emitted with spellcheckWordsChunkParsed().
+   * \param[in] fileName Name of the file that was parsed.
+   * \param[in] wordlist All words of the file that must be checked.
+   * \param[in] generation Generation of the dictionary, see
+   *      SpellCheckerCore::dictionaryGeneration(), that the words marked as
+   *      Word::checked were judged with. */
+  void spellcheckWordsParsed( const QString& fileName, const SpellChecker::WordList& wordlist, quint64 generation );
+  /*! \brief Signal emitted with a chunk of words of a file that is still
+   * being parsed.
+   *
+   * Parsers can stream the words of large files in chunks so that the
+   * core can check and underline them before the whole file is parsed.
+   * Each word of the file should be in one chunk only and the chunks must
+   * be followed by spellcheckWordsParsed() for the same file. Parsers that do
+   * not stream only emit spellcheckWordsParsed().
+   * \param[in] fileName Name of the file that the words belong to.
+   * \param[in] wordlist Words of the chunk that must be checked.
+   * \param[in] generation Generation of the dictionary that the words marked
+   *      as Word::checked were judged with. */
+  void spellcheckWordsChunkParsed( const QString& fileName, const SpellChecker::WordList& wordlist, quint64 generation );
+  /*! \brief Signal emitted instead of spellcheckWordsParsed() if the words of
+   * a file did not change since the previous time that it was parsed.
+   *
+   * The words might have moved, \a mistakes are the mistakes of the file at
+   * their current positions. The core does not have to check the words again,
+   * at most it has to move the mistakes that it has for the file.
+   * \param[in] fileName Name of the file that was parsed.
+   * \param[in] mistakes Mistakes of the file, all marked as Word::checked.
+   * \param[in] generation Generation of the dictionary that the \a mistakes
+   *      were judged with. */
+  void spellcheckWordsUnchanged( const QString& fileName, const SpellChecker::WordList& mistakes, quint64 generation );
 
 public slots:
   /*! Slot that will get called when the current editor changes.
@@ -88,6 +122,15 @@ public slots:
    * and then it is passed to the parsers. The parsers then does not need
    * to get the source files as well. */
   virtual void updateProjectFiles( QStringSet filesAdded, QStringSet filesRemoved ) { Q_UNUSED( filesAdded ) Q_UNUSED( filesRemoved ) }
+  /*! Slot that will get called when the visible lines of the current
+   * editor changes, for example when the user scrolls.
+   *
+   * Parsers can use this to parse the visible part of the current file first
+   * and stream those words before the rest of the file.
+   * \param[in] editorFilePath File path of the current editor.
+   * \param[in] firstLine First visible line, 1 based.
+   * \param[in] lastLine Last visible line, 1 based. */
+  virtual void setVisibleRange( const QString& editorFilePath, int32_t firstLine, int32_t lastLine ) { Q_UNUSED( editorFilePath ) Q_UNUSED( firstLine ) Q_UNUSED( lastLine ) }
 };
 
 } // namespace SpellChecker
@@ -22,6 +22,7 @@
 #include "ISpellChecker.h"
 #include "NavigationWidget.h"
 #include "outputpane.h"
+#include "Pipeline.h"
 #include "spellcheckerconstants.h"
 #include "spellcheckercore.h"
 #include "spellcheckercoreoptionswidget.h"
@@ -38,28 +39,195 @@
 #include <coreplugin/actionmanager/actionmanager.h>
 #include <coreplugin/actionmanager/command.h>
 #include <coreplugin/coreconstants.h>
+#include <coreplugin/editormanager/documentmodel.h>
 #include <coreplugin/editormanager/ieditor.h>
 #include <coreplugin/icore.h>
 #include <coreplugin/idocument.h>
+#include <coreplugin/messagemanager.h>
 #include <cppeditor/cppmodelmanager.h>
+#include <texteditor/textdocument.h>
 #include <texteditor/texteditor.h>
 #include <utils/algorithm.h>
 #include <utils/fadingindicator.h>
 #include <utils/async.h>
 #include <utils/fileutils.h>
+#include <utils/textfileformat.h>
 
 #include <QFuture>
 #include <QFutureWatcher>
 #include <QMenu>
 #include <QMouseEvent>
+#include <QElapsedTimer>
 #include <QMutex>
 #include <QPointer>
 #include <QtConcurrent>
+#include <QScrollBar>
 #include <QTextBlock>
 #include <QTextCursor>
+#include <QTimer>
 
-using FutureWatcherMap     = QMap<QFutureWatcher<SpellChecker::WordList>*, QString>;
+#include <atomic>
+
+// #define BENCH_TIME
+
+using FutureWatcherMap     = QMap<QFutureWatcher<SpellChecker::WordList>*, SpellChecker::FileId>;
 using FutureWatcherMapIter = FutureWatcherMap::Iterator;
+/*! \brief Words that a watcher is checking and the generation of the dictionary
+ * when the check started. */
+using CheckedWordsMap = QHash<QFutureWatcher<SpellChecker::WordList>*, QPair<SpellChecker::WordList, quint64>>;
+
+namespace {
+/*! \brief Interval at which queued mistakes are published to the models. */
+constexpr int32_t cPUBLISH_INTERVAL_MS = 50;
+/*! \brief Time that one flush of the publish queue should take at most. */
+constexpr qint64 cPUBLISH_BUDGET_US = 10000;
+/*! \brief Bounds of the number of files published in one flush. */
+constexpr int32_t cPUBLISH_MIN_BATCH = 4;
+constexpr int32_t cPUBLISH_MAX_BATCH = 512;
+} // namespace
+
+/*! \brief State of a file that a parser streams in chunks. */
+struct StreamedFile
+{
+  quint64 id = 0;            /*!< Identifier to ignore chunks of a previous stream of the file. */
+  SpellChecker::WordList baseMistakes; /*!< Mistakes of the file before the stream started. */
+  SpellChecker::WordList mistakes;     /*!< Mistakes in the chunks checked so far. */
+  QSet<quint64> positions;   /*!< Positions of all words received in chunks. */
+  int32_t wordCount     = 0; /*!< Number of words received in chunks. */
+  int32_t pendingChunks = 0; /*!< Chunks still being checked. */
+  bool committed        = false; /*!< The parser committed the file. */
+  SpellChecker::WordList words;  /*!< All words of the file, set when the parser committed the file. */
+  quint64 generation    = 0; /*!< Generation of the dictionary when the stream started. */
+};
+/*! \brief Words of a file that wait on a stage of the pipeline. */
+struct StageWords
+{
+  SpellChecker::WordList words;
+  SpellChecker::CancellationToken token; /*!< Token that the file was registered on the stage with. */
+  quint64 generation = 0; /*!< Generation of the dictionary that the checked \a words were judged with. */
+};
+/*! \brief Chunk that a watcher is checking, the file and the identifier of the stream. */
+using ChunkWatcherMap = QHash<QFutureWatcher<SpellChecker::WordList>*, QPair<QString, quint64>>;
+
+/*! \brief Key of an underline selection of a mistake in the current editor. */
+struct SelectionKey
+{
+  int32_t line;
+  int32_t column;
+  int32_t length;
+  QString text;
+
+  bool operator==( const SelectionKey& other ) const
+  {
+    return ( line == other.line )
+           && ( column == other.column )
+           && ( length == other.length )
+           && ( text == other.text );
+  }
+};
+
+static size_t qHash( const SelectionKey& key, size_t seed = 0 )
+{
+  return qHashMulti( seed, key.line, key.column, key.length, key.text );
+}
+
+/*! \brief Check if the \a cursor of a previous selection still selects the \a word.
+ *
+ * The cursor moves with edits in the document, if the text before it changed
+ * on the same line it will no longer be at the column of the word. */
+static bool selectionMatchesWord( const QTextCursor& cursor, const SpellChecker::Word& word )
+{
+  if( cursor.isNull() == true ) {
+    return false;
+  }
+  const QTextBlock block = cursor.block();
+  return ( block.blockNumber() == ( word.lineNumber - 1 ) )
+         && ( ( cursor.selectionStart() - block.position() ) == ( word.columnNumber - 1 ) )
+         && ( cursor.selectedText() == word.text );
+}
+
+/*! \brief Key of the position of a word in a file. */
+static quint64 positionKey( const SpellChecker::Word& word )
+{
+  return ( quint64( uint32_t( word.lineNumber ) ) << 32 ) | uint32_t( word.columnNumber );
+}
+
+/*! \brief Sort the \a words on their position, the last word first.
+ *
+ * Words are replaced from the end of the text to the start so that the
+ * positions of the words that must still be replaced do not move. */
+static QVector<SpellChecker::Word> wordsInReverseOrder( const SpellChecker::WordList& words )
+{
+  QVector<SpellChecker::Word> sorted;
+  sorted.reserve( words.size() );
+  for( const SpellChecker::Word& word: words ) {
+    sorted.append( word );
+  }
+  std::sort( sorted.begin(), sorted.end(), []( const SpellChecker::Word& lhs, const SpellChecker::Word& rhs ) {
+    return ( lhs.lineNumber > rhs.lineNumber )
+           || ( ( lhs.lineNumber == rhs.lineNumber )
+                && ( lhs.columnNumber > rhs.columnNumber ) );
+  } );
+  return sorted;
+}
+
+/*! \brief Replace the \a words in the \a document with the \a replacement.
+ *
+ * All words are replaced in one edit block so that it can be undone in one
+ * step. Words that are no longer at their position are skipped.
+ * \return The number of words that were replaced. */
+static int32_t replaceWordsInDocument( QTextDocument* document, const SpellChecker::WordList& words, const QString& replacement )
+{
+  int32_t replaced = 0;
+  QTextCursor cursor( document );
+  cursor.beginEditBlock();
+  for( const SpellChecker::Word& word: wordsInReverseOrder( words ) ) {
+    const QTextBlock block = document->findBlockByNumber( word.lineNumber - 1 );
+    if( ( block.isValid() == false )
+        || ( block.length() < ( word.columnNumber - 1 + word.length ) ) ) {
+      continue;
+    }
+    const int32_t start = block.position() + word.columnNumber - 1;
+    cursor.setPosition( start );
+    cursor.setPosition( start + word.length, QTextCursor::KeepAnchor );
+    if( cursor.selectedText() != word.text ) {
+      continue;
+    }
+    cursor.insertText( replacement );
+    ++replaced;
+  }
+  cursor.endEditBlock();
+  return replaced;
+}
+
+/*! \brief Replace the \a words in the \a text of a file with the \a replacement.
+ *
+ * Words that are no longer at their position are skipped.
+ * \return The number of words that were replaced. */
+static int32_t replaceWordsInText( QString& text, const SpellChecker::WordList& words, const QString& replacement )
+{
+  /* The start of each line, the lines of the words are 1 based. */
+  QVector<int32_t> lineStarts{ 0 };
+  for( int32_t index = 0; index < text.size(); ++index ) {
+    if( text.at( index ) == QLatin1Char( '\n' ) ) {
+      lineStarts.append( index + 1 );
+    }
+  }
+  int32_t replaced = 0;
+  for( const SpellChecker::Word& word: wordsInReverseOrder( words ) ) {
+    if( ( word.lineNumber < 1 )
+        || ( word.lineNumber > lineStarts.size() ) ) {
+      continue;
+    }
+    const int32_t start = lineStarts.at( word.lineNumber - 1 ) + word.columnNumber - 1;
+    if( QStringView( text ).mid( start, word.length ) != word.text ) {
+      continue;
+    }
+    text.replace( start, word.length, replacement );
+    ++replaced;
+  }
+  return replaced;
+}
 
 class SpellChecker::Internal::SpellCheckerCorePrivate
 {
@@ -70,6 +238,7 @@ public:
   SpellChecker::Internal::SpellingMistakesModel* mistakesModel;
   SpellChecker::Internal::OutputPane* outputPane;
   SpellChecker::Internal::SpellCheckerCoreSettings settings;
+  SharedSnapshot<SpellChecker::Internal::SpellCheckerCoreSettings> settingsSnapshot; /*!< Snapshot of the \a settings for other threads. */
   SpellChecker::Internal::SpellCheckerCoreOptionsPage optionsPage{&settings, [this] { /*settingsChanged(settings);*/ }};
   QMap<QString, ISpellChecker*> addedSpellCheckers;
   SpellChecker::ISpellChecker*  spellChecker;
@@ -78,11 +247,30 @@ public:
   QList<Core::Command*> contextMenuHolderCommands;
   QString currentFilePath;
   ProjectExplorer::Project* startupProject;
-  QStringSet filesInStartupProject;
+  FileIdSet filesInStartupProject;
   QMutex futureMutex;
   FutureWatcherMap futureWatchers;
-  QStringList filesInProcess;
-  QHash<QString, WordList> filesWaitingForProcess;
+  CheckedWordsMap checkedWords;   /*!< Words checked by the watchers in \a futureWatchers. */
+  FileIdSet filesInProcess;
+  QHash<QString, StageWords> filesWaitingForProcess; /*!< Files waiting for the Check stage, each
+                                                      * entry is registered as waiting on the stage. */
+  QHash<QString, StreamedFile> streamedFiles;
+  ChunkWatcherMap chunkWatchers;
+  quint64 nextStreamId = 1;
+  Pipeline pipeline;
+  QHash<SelectionKey, QTextEdit::ExtraSelection> editorSelections; /*!< Selections applied to the current
+                                             * editor, only for the mistakes near the visible blocks. */
+  QPointer<TextEditor::TextEditorWidget> selectionsWidget; /*!< Editor widget of the selections. */
+  QColor selectionsColor;                   /*!< Underline color of the selections. */
+  QTimer visibleRangeTimer;                 /*!< Debounce the scrolling of the current editor. */
+  QHash<QString, StageWords> publishQueue;  /*!< Mistakes of files waiting to be published. */
+  QStringList publishOrder;                 /*!< Files in the \a publishQueue, oldest first. */
+  QTimer publishTimer;                      /*!< Timer to flush the \a publishQueue. */
+  int32_t publishBatchSize = 32;            /*!< Files to publish in the next flush, adapted
+                                             * to the duration of the previous flushes. */
+  QMetaObject::Connection scrollConnection; /*!< Connection to the scroll bar of the current editor. */
+  std::atomic<quint64> dictionaryGeneration{ 1 }; /*!< Changes when the verdict of a word can change. */
+  quint64 unchangedFilesSkipped = 0;        /*!< Files that were not checked since their words did not change. */
   bool shuttingDown = false;
 
   SpellCheckerCorePrivate()
@@ -111,6 +299,7 @@ SpellCheckerCore::SpellCheckerCore( QObject* parent )
   g_instance = this;
 
   d->settings.loadFromSettings( Core::ICore::settings() );
+  d->settingsSnapshot.publish( d->settings );
   d->spellingMistakesModel = new ProjectMistakesModel();
 
   d->mistakesModel = new SpellingMistakesModel( this );
@@ -136,6 +325,25 @@ SpellCheckerCore::SpellCheckerCore( QObject* parent )
 
   connect(Core::ICore::instance(), &Core::ICore::saveSettingsRequested,
           this, [this] { d->settings.saveToSettings(Core::ICore::settings()); });
+  /* The snapshot is published before the parsers get notified about the
+   * change, they must already see the new settings when they parse again.
+   * Settings that only change how mistakes are shown do not need the files
+   * to be parsed again, only the editor must be updated. */
+  connect( &d->settings, &SpellChecker::Internal::SpellCheckerCoreSettings::settingsChanged, this, [this]( SettingsChanges changes ) {
+    d->settingsSnapshot.publish( d->settings );
+    if( changes.testFlag( SettingsChange::Render ) == true ) {
+      updateEditorSelections();
+    }
+  } );
+
+  /* Only notify the parsers about the visible lines once the user stopped
+   * scrolling for a moment. */
+  d->visibleRangeTimer.setSingleShot( true );
+  d->visibleRangeTimer.setInterval( 100 );
+  connect( &d->visibleRangeTimer, &QTimer::timeout, this, &SpellCheckerCore::updateVisibleRange );
+  d->publishTimer.setSingleShot( true );
+  d->publishTimer.setInterval( cPUBLISH_INTERVAL_MS );
+  connect( &d->publishTimer, &QTimer::timeout, this, &SpellCheckerCore::flushPublishQueue );
 }
 // --------------------------------------------------
 
@@ -164,7 +372,10 @@ bool SpellCheckerCore::addDocumentParser( IDocumentParser* parser )
     connect( this,   &SpellCheckerCore::currentEditorChanged, parser, &IDocumentParser::setCurrentEditor );
     connect( this,   &SpellCheckerCore::activeProjectChanged, parser, &IDocumentParser::setActiveProject );
     connect( this,   &SpellCheckerCore::projectFilesChanged,  parser, &IDocumentParser::updateProjectFiles );
+    connect( this,   &SpellCheckerCore::visibleRangeChanged,  parser, &IDocumentParser::setVisibleRange );
     connect( parser, &IDocumentParser::spellcheckWordsParsed, this,   &SpellCheckerCore::spellcheckWordsFromParser, Qt::QueuedConnection );
+    connect( parser, &IDocumentParser::spellcheckWordsChunkParsed, this, &SpellCheckerCore::spellcheckWordChunkFromParser, Qt::QueuedConnection );
+    connect( parser, &IDocumentParser::spellcheckWordsUnchanged, this, &SpellCheckerCore::spellcheckUnchangedFromParser, Qt::QueuedConnection );
     return true;
   }
   return false;
@@ -180,7 +391,10 @@ void SpellCheckerCore::removeDocumentParser( IDocumentParser* parser )
   disconnect( this,   &SpellCheckerCore::currentEditorChanged, parser, &IDocumentParser::setCurrentEditor );
   disconnect( this,   &SpellCheckerCore::activeProjectChanged, parser, &IDocumentParser::setActiveProject );
   disconnect( this,   &SpellCheckerCore::projectFilesChanged,  parser, &IDocumentParser::updateProjectFiles );
+  disconnect( this,   &SpellCheckerCore::visibleRangeChanged,  parser, &IDocumentParser::setVisibleRange );
   disconnect( parser, &IDocumentParser::spellcheckWordsParsed, this,   &SpellCheckerCore::spellcheckWordsFromParser );
+  disconnect( parser, &IDocumentParser::spellcheckWordsChunkParsed, this, &SpellCheckerCore::spellcheckWordChunkFromParser );
+  disconnect( parser, &IDocumentParser::spellcheckWordsUnchanged, this, &SpellCheckerCore::spellcheckUnchangedFromParser );
   /* Remove the parser from the Core. The removeOne() function is used since
    * the check in the addDocumentParser() would prevent the list from having
    * more than one occurrence of the parser in the list of parsers */
@@ -203,6 +417,18 @@ void SpellCheckerCore::addMisspelledWords( const QString& fileName, const WordLi
   if( d->currentFilePath != fileName ) {
     return;
   }
+  updateEditorSelections();
+
+  /* The model updated, check if the word under the cursor is now a mistake
+   * and notify the rest of the checker with this information. */
+  Word word;
+  bool wordIsMisspelled = isWordUnderCursorMistake( word );
+  emit wordUnderCursorMistake( wordIsMisspelled, word );
+}
+// --------------------------------------------------
+
+void SpellCheckerCore::updateEditorSelections()
+{
   TextEditor::BaseTextEditor* baseEditor = qobject_cast<TextEditor::BaseTextEditor*>( d->currentEditor );
   if( baseEditor == nullptr ) {
     return;
@@ -215,11 +441,41 @@ void SpellCheckerCore::addMisspelledWords( const QString& fileName, const WordLi
   if( document == nullptr ) {
     return;
   }
-  QList<QTextEdit::ExtraSelection> selections;
-  selections.reserve( words.size() );
-  const WordList::ConstIterator wordsEnd = words.constEnd();
-  for( WordList::ConstIterator wordIter = words.constBegin(); wordIter != wordsEnd; ++wordIter ) {
-    const Word& word = wordIter.value();
+  /* The selections of a different editor or with a different color can not
+   * be reused. */
+  if( ( d->selectionsWidget != editorWidget )
+      || ( d->selectionsColor != d->settings.underlineColor ) ) {
+    d->editorSelections.clear();
+    d->selectionsWidget = editorWidget;
+    d->selectionsColor  = d->settings.underlineColor;
+  }
+
+  /* Only the mistakes in the visible blocks and a page above and below them
+   * are underlined, the rest is underlined when the user scrolls to them. */
+  const int32_t firstVisible = editorWidget->firstVisibleBlockNumber() + 1;
+  const int32_t lastVisible  = editorWidget->lastVisibleBlockNumber() + 1;
+  const int32_t page         = lastVisible - firstVisible + 1;
+  const int32_t firstLine    = firstVisible - page;
+  const int32_t lastLine     = lastVisible + page;
+
+  /* Only underline the mistake, the rest of the format of the text stays
+   * as is, thus there is no need to get the format of the text. */
+  QTextCharFormat format;
+  format.setFontUnderline( true );
+  format.setUnderlineColor( d->settings.underlineColor );
+  format.setUnderlineStyle( QTextCharFormat::WaveUnderline );
+
+  QHash<SelectionKey, QTextEdit::ExtraSelection> selections;
+  bool newSelections = false;
+  const QVector<Word> words = d->spellingMistakesModel->mistakesInLines( d->currentFilePath, firstLine, lastLine );
+  for( const Word& word: words ) {
+    const SelectionKey key{ word.lineNumber, word.columnNumber, word.length, word.text };
+    const auto cached = d->editorSelections.constFind( key );
+    if( ( cached != d->editorSelections.constEnd() )
+        && ( selectionMatchesWord( cached->cursor, word ) == true ) ) {
+      selections.insert( key, cached.value() );
+      continue;
+    }
     /* Get the QTextBlock for the line that the misspelled word is on.
      * The QTextDocument manages lines as blocks (in most cases).
      * The lineNumber of the misspelled word is 1 based (seen in the editor)
@@ -240,27 +496,24 @@ void SpellCheckerCore::addMisspelledWords( const QString& fileName, const WordLi
     QTextCursor cursor( block );
     cursor.setPosition( cursor.position() + int32_t( word.columnNumber ) - 1 );
     cursor.movePosition( QTextCursor::Right, QTextCursor::KeepAnchor, word.length );
-    /* Get the current format from the cursor, this is to make sure that the text font
-     * and color stays the same, we just want to underline the mistake. */
-    QTextCharFormat format = cursor.charFormat();
-    format.setFontUnderline( true );
-    format.setUnderlineColor( d->settings.underlineColor );
-    format.setUnderlineStyle( QTextCharFormat::WaveUnderline );
+    /* The tooltip is only created for the selections that are created. */
     format.setToolTip( word.suggestions.isEmpty()
                        ? QStringLiteral( "Incorrect spelling" )
                        : QStringLiteral( "Incorrect spelling, did you mean '%1' ?" ).arg( word.suggestions.first() ) );
     QTextEdit::ExtraSelection selection;
     selection.cursor = cursor;
     selection.format = format;
-    selections.append( selection );
+    selections.insert( key, selection );
+    newSelections = true;
   }
-  editorWidget->setExtraSelections( Utils::Id( SpellChecker::Constants::SPELLCHECK_MISTAKE_ID ), selections );
-
-  /* The model updated, check if the word under the cursor is now a mistake
-   * and notify the rest of the checker with this information. */
-  Word word;
-  bool wordIsMisspelled = isWordUnderCursorMistake( word );
-  emit wordUnderCursorMistake( wordIsMisspelled, word );
+  /* All selections were reused, if there are as many as before nothing
+   * changed and the editor does not need to update. */
+  if( ( newSelections == false )
+      && ( selections.size() == d->editorSelections.size() ) ) {
+    return;
+  }
+  d->editorSelections = selections;
+  editorWidget->setExtraSelections( Utils::Id( SpellChecker::Constants::SPELLCHECK_MISTAKE_ID ), d->editorSelections.values() );
 }
 // --------------------------------------------------
 
@@ -312,11 +565,26 @@ void SpellCheckerCore::setSpellChecker( ISpellChecker* spellChecker )
     d->addedSpellCheckers.insert( spellChecker->name(), spellChecker );
   }
 
-  d->spellChecker = spellChecker;
+  if( d->spellChecker != spellChecker ) {
+    d->spellChecker = spellChecker;
+    ++d->dictionaryGeneration;
+  }
+}
+// --------------------------------------------------
+
+quint64 SpellCheckerCore::dictionaryGeneration() const
+{
+  return d->dictionaryGeneration;
+}
+// --------------------------------------------------
+
+quint64 SpellCheckerCore::unchangedFilesSkipped() const
+{
+  return d->unchangedFilesSkipped;
 }
 // --------------------------------------------------
 
-void SpellCheckerCore::spellcheckWordsFromParser( const QString& fileName, const WordList& words )
+void SpellCheckerCore::spellcheckWordsFromParser( const QString& fileName, const WordList& words, quint64 generation )
 {
   /* Lock the mutex to prevent threading issues. This might not be needed since
    * queued connections are used and this function should always execute in the
@@ -327,6 +595,35 @@ void SpellCheckerCore::spellcheckWordsFromParser( const QString& fileName, const
     return;
   }
 
+  /* If the words of the file were streamed in chunks, the chunks were
+   * already checked. If all the words were received, the mistakes of the
+   * chunks are the mistakes of the file. */
+  QHash<QString, StreamedFile>::iterator streamIter = d->streamedFiles.find( fileName );
+  if( streamIter != d->streamedFiles.end() ) {
+    /* If the dictionary changed during the stream, the chunks that were
+     * checked before the change are outdated. */
+    if( ( streamIter->wordCount == words.count() )
+        && ( streamIter->generation == d->dictionaryGeneration ) ) {
+      if( streamIter->pendingChunks > 0 ) {
+        /* Publish once the last chunk was checked. */
+        streamIter->committed = true;
+        streamIter->words     = words;
+        return;
+      }
+      const WordList mistakes  = streamIter->mistakes;
+      const quint64 generation = streamIter->generation;
+      d->streamedFiles.erase( streamIter );
+      locker.unlock();
+      publishMistakes( fileName, mistakes );
+      emit wordsChecked( fileName, words, mistakes, generation );
+      return;
+    }
+    /* The chunks do not match the words of the file or are outdated, check
+     * the words as if they were not streamed. */
+    d->streamedFiles.erase( streamIter );
+  }
+
+  PipelineStage* checkStage = d->pipeline.stage( Pipeline::Check );
   /* Check if this file is not already being processed by QtConcurrent in the
    * background. The current implementation will only use one QFuter per file
    * and if spell checking is requested for the same file if it is already being
@@ -334,52 +631,332 @@ void SpellCheckerCore::spellcheckWordsFromParser( const QString& fileName, const
    * if the current QFuture completes. This prevents possible redundant spell checking
    * but can result in a bit of a latency to update new words. It will however reduce
    * the amount of processing, especially if code is edited, and not comments and
-   * literals. */
-  if( d->filesInProcess.contains( fileName ) == true ) {
-    /* There is already a QFuture out for the given file. Add it to the list of
-     * of waiting files and replace the current set of words with the latest ones.
-     * The assumption is that the last call to this function will always contain
-     * the latest words that should be spell checked. */
-    d->filesWaitingForProcess[fileName] = words;
-  } else {
-    /* Get the list of mistakes that were extracted on the file during the last
-     * run of the processing. */
-    WordList previousMistakes = d->spellingMistakesModel->mistakesForFile( fileName );
-    /* There is no background process processing the words for the given file.
-     * Create a processor and start processing the spelling mistakes in the
-     * background using QtConcurrent and a QFuture. */
-    SpellCheckProcessor* processor    = new SpellCheckProcessor( d->spellChecker, fileName, words, previousMistakes );
-    QFutureWatcher<WordList>* watcher = new QFutureWatcher<WordList>();
-    connect( watcher, &QFutureWatcher<WordList>::finished, this, &SpellCheckerCore::futureFinished, Qt::QueuedConnection );
-    /* Keep track of the watchers that are busy and the file that it is working on.
-     * Since all QFuterWatchers are connected to the same slot, this map is used
-     * to map the correct watcher to the correct file. */
-    d->futureWatchers.insert( watcher, fileName );
-    /* This is just a convenience list to speed up checking if a file is getting
-     * processed already. An alternative would be to iterate through the above map
-     * and check where the value matches the file. This can be slow especially if
-     * there are multiple watchers running. The separate list can use indexing and
-     * other search technicians compared to the mentioned iteration search. */
-    d->filesInProcess.append( fileName );
-    /* Make sure that the processor gets cleaned up after it has finished processing
-     * the words. */
-    connect( watcher, &QFutureWatcher<WordList>::finished, processor, &SpellCheckProcessor::deleteLater );
-
-    /* Create a future to process the file.
-     * If the file to process is the current open editor, it is processed in a new
-     * thread with high priority.
-     * If it is not the current file, it is added to the global thread pool
-     * since it can get processed in its own time.
-     * The current one gets a new thread so that it can get processed as
-     * soon as possible and it does not need to get queued along with all other
-     * futures added to the global thread pool. */
-    if( fileName == d->currentFilePath ) {
-      QFuture<WordList> future = Utils::asyncRun( QThread::HighPriority, &SpellCheckProcessor::process, processor );
-      watcher->setFuture( future );
+   * literals.
+   *
+   * The same list is used if the Check stage is full. The current file is
+   * never held back since it is what the user is looking at. */
+  const bool stageFull = ( checkStage->canStart() == false ) && ( fileName != d->currentFilePath );
+  if( ( d->filesInProcess.contains( fileName ) == true )
+      || ( stageFull == true ) ) {
+    /* Add it to the list of waiting files and replace the current set of words
+     * with the latest ones. The assumption is that the last call to this function
+     * will always contain the latest words that should be spell checked. */
+    const QHash<QString, StageWords>::iterator waitingIter = d->filesWaitingForProcess.find( fileName );
+    if( waitingIter == d->filesWaitingForProcess.end() ) {
+      d->filesWaitingForProcess.insert( fileName, { words, checkStage->enqueue(), generation } );
     } else {
-      QFuture<WordList> future = Utils::asyncRun( QThreadPool::globalInstance(), QThread::LowPriority, &SpellCheckProcessor::process, processor );
-      watcher->setFuture( future );
+      waitingIter->words      = words;
+      waitingIter->generation = generation;
+    }
+  } else {
+    /* Older words that were waiting for the file are replaced by these. */
+    const QHash<QString, StageWords>::iterator waitingIter = d->filesWaitingForProcess.find( fileName );
+    if( waitingIter != d->filesWaitingForProcess.end() ) {
+      checkStage->dequeue( waitingIter->token );
+      d->filesWaitingForProcess.erase( waitingIter );
+    }
+    startSpellCheck( fileName, words, generation );
+  }
+}
+// --------------------------------------------------
+
+void SpellCheckerCore::spellcheckUnchangedFromParser( const QString& fileName, const WordList& mistakes, quint64 generation )
+{
+  QMutexLocker locker( &d->futureMutex );
+  if( d->shuttingDown == true ) {
+    return;
+  }
+  /* If the file is still being checked or streamed, the results of that will
+   * be published later with the previous positions. Handle the mistakes like
+   * any other words then, they are all checked and pass through the Check
+   * stage without using the spell checker. The same if the dictionary changed
+   * since the mistakes were judged, they are checked again then. */
+  if( ( d->filesInProcess.contains( fileName ) == true )
+      || ( d->filesWaitingForProcess.contains( fileName ) == true )
+      || ( d->streamedFiles.contains( fileName ) == true )
+      || ( generation != d->dictionaryGeneration ) ) {
+    locker.unlock();
+    spellcheckWordsFromParser( fileName, mistakes, generation );
+    return;
+  }
+  ++d->unchangedFilesSkipped;
+  locker.unlock();
+
+  /* Only publish the mistakes if they moved, otherwise the models and the
+   * underlines are already up to date. */
+  const QHash<QString, StageWords>::const_iterator queueIter = d->publishQueue.constFind( fileName );
+  const WordList published = ( queueIter != d->publishQueue.constEnd() )
+                             ? queueIter->words
+                             : d->spellingMistakesModel->mistakesForFile( fileName );
+  bool moved = ( published.count() != mistakes.count() );
+  if( moved == false ) {
+    QSet<quint64> positions;
+    positions.reserve( published.count() );
+    for( const Word& word: published ) {
+      positions.insert( positionKey( word ) );
+    }
+    for( const Word& word: mistakes ) {
+      if( positions.contains( positionKey( word ) ) == false ) {
+        moved = true;
+        break;
+      }
+    }
+  }
+#ifdef BENCH_TIME
+  qDebug() << "File: " << fileName
+           << "\n  - unchanged, moved: " << moved
+           << "\n  - skipped: " << d->unchangedFilesSkipped;
+#endif /* BENCH_TIME */
+  if( moved == true ) {
+    publishMistakes( fileName, mistakes );
+  }
+}
+// --------------------------------------------------
+
+void SpellCheckerCore::spellcheckWordChunkFromParser( const QString& fileName, const WordList& words, quint64 generation )
+{
+  QMutexLocker locker( &d->futureMutex );
+  if( d->shuttingDown == true ) {
+    return;
+  }
+
+  QHash<QString, StreamedFile>::iterator streamIter = d->streamedFiles.find( fileName );
+  if( ( streamIter == d->streamedFiles.end() )
+      || ( streamIter->committed == true ) ) {
+    /* First chunk of the file, or of a new parse of the file. The chunks of a
+     * committed stream that are still in process will be ignored. */
+    StreamedFile stream;
+    stream.id           = d->nextStreamId++;
+    stream.baseMistakes = d->spellingMistakesModel->mistakesForFile( fileName );
+    stream.generation   = d->dictionaryGeneration;
+    streamIter          = d->streamedFiles.insert( fileName, stream );
+  }
+  StreamedFile& stream = streamIter.value();
+  stream.wordCount += words.count();
+  for( const Word& word: words ) {
+    stream.positions.insert( positionKey( word ) );
+  }
+  ++stream.pendingChunks;
+
+  /* The chunk is checked on the Check stage like a file, the suggestions of
+   * the mistakes of the file before the stream are reused. */
+  SpellCheckProcessor* processor    = new SpellCheckProcessor( d->spellChecker, fileName, words, stream.baseMistakes, generation );
+  QFutureWatcher<WordList>* watcher = new QFutureWatcher<WordList>();
+  connect( watcher, &QFutureWatcher<WordList>::finished, this,      &SpellCheckerCore::chunkFutureFinished, Qt::QueuedConnection );
+  connect( watcher, &QFutureWatcher<WordList>::finished, processor, &SpellCheckProcessor::deleteLater );
+  d->chunkWatchers.insert( watcher, qMakePair( fileName, stream.id ) );
+  const bool urgent = ( fileName == d->currentFilePath );
+  watcher->setFuture( d->pipeline.stage( Pipeline::Check )->run( urgent, &SpellCheckProcessor::process, processor ) );
+}
+// --------------------------------------------------
+
+void SpellCheckerCore::chunkFutureFinished()
+{
+  QFutureWatcher<WordList>* watcher = reinterpret_cast<QFutureWatcher<WordList>*>( sender() );
+  if( watcher == nullptr ) {
+    return;
+  }
+  if( ( d->shuttingDown == true )
+      || ( watcher->isCanceled() == true ) ) {
+    return;
+  }
+  const WordList checkedWords = watcher->result();
+  QMutexLocker locker( &d->futureMutex );
+  if( d->shuttingDown == true ) {
+    return;
+  }
+  ChunkWatcherMap::iterator iter = d->chunkWatchers.find( watcher );
+  if( iter == d->chunkWatchers.end() ) {
+    return;
+  }
+  const QString fileName = iter->first;
+  const quint64 streamId = iter->second;
+  d->chunkWatchers.erase( iter );
+  watcher->deleteLater();
+  /* The chunk left the Check stage, start the files that were waiting for
+   * room on it. */
+  startWaitingSpellChecks();
+
+  QHash<QString, StreamedFile>::iterator streamIter = d->streamedFiles.find( fileName );
+  if( ( streamIter == d->streamedFiles.end() )
+      || ( streamIter->id != streamId ) ) {
+    /* Chunk of a stream that is no longer relevant. */
+    locker.unlock();
+    d->pipeline.notifyCapacity();
+    return;
+  }
+  StreamedFile& stream = streamIter.value();
+  stream.mistakes.append( checkedWords );
+  --stream.pendingChunks;
+
+  if( ( stream.committed == true )
+      && ( stream.pendingChunks == 0 ) ) {
+    /* The last chunk of a committed file, publish the mistakes of the file. */
+    const WordList mistakes  = stream.mistakes;
+    const WordList words     = stream.words;
+    const quint64 generation = stream.generation;
+    d->streamedFiles.erase( streamIter );
+    locker.unlock();
+    publishMistakes( fileName, mistakes );
+    emit wordsChecked( fileName, words, mistakes, generation );
+  } else if( fileName == d->currentFilePath ) {
+    /* Publish the mistakes found so far for the current file. Mistakes from
+     * before the stream are kept for words that were not received again yet
+     * so that the underlines in the rest of the file do not disappear. */
+    WordList provisional = stream.mistakes;
+    for( const Word& word: qAsConst( stream.baseMistakes ) ) {
+      if( stream.positions.contains( positionKey( word ) ) == false ) {
+        provisional.append( word );
+      }
     }
+    locker.unlock();
+    addMisspelledWords( fileName, provisional );
+  } else {
+    locker.unlock();
+  }
+  d->pipeline.notifyCapacity();
+}
+// --------------------------------------------------
+
+void SpellCheckerCore::publishMistakes( const QString& fileName, const WordList& words )
+{
+  if( fileName == d->currentFilePath ) {
+    /* The user is looking at the file, do not delay it. Older mistakes
+     * of the file that are still queued are replaced by these. */
+    WordList queued;
+    takeQueuedMistakes( fileName, queued );
+    addMisspelledWords( fileName, words );
+    return;
+  }
+  QHash<QString, StageWords>::iterator queueIter = d->publishQueue.find( fileName );
+  if( queueIter != d->publishQueue.end() ) {
+    /* Still waiting, only the latest mistakes are published. */
+    queueIter->words = words;
+    return;
+  }
+  d->publishQueue.insert( fileName, { words, d->pipeline.stage( Pipeline::Publish )->enqueue() } );
+  d->publishOrder.append( fileName );
+  if( d->publishTimer.isActive() == false ) {
+    d->publishTimer.start();
+  }
+}
+// --------------------------------------------------
+
+bool SpellCheckerCore::takeQueuedMistakes( const QString& fileName, WordList& words )
+{
+  QHash<QString, StageWords>::iterator queueIter = d->publishQueue.find( fileName );
+  if( queueIter == d->publishQueue.end() ) {
+    return false;
+  }
+  words = queueIter->words;
+  d->pipeline.stage( Pipeline::Publish )->dequeue( queueIter->token );
+  d->publishQueue.erase( queueIter );
+  d->publishOrder.removeOne( fileName );
+  return true;
+}
+// --------------------------------------------------
+
+void SpellCheckerCore::flushPublishQueue()
+{
+  if( ( d->shuttingDown == true )
+      || ( d->publishOrder.isEmpty() == true ) ) {
+    return;
+  }
+  QElapsedTimer timer;
+  timer.start();
+  const int32_t batchSize = std::min( d->publishBatchSize, int32_t( d->publishOrder.size() ) );
+  QList<ProjectMistakesModel::FileUpdate> updates;
+  QList<CancellationToken> tokens;
+  updates.reserve( batchSize );
+  tokens.reserve( batchSize );
+  for( int32_t index = 0; index < batchSize; ++index ) {
+    const QString fileName = d->publishOrder.takeFirst();
+    const StageWords queued = d->publishQueue.take( fileName );
+    updates.append( { fileName, queued.words, d->filesInStartupProject.contains( fileName ) } );
+    tokens.append( queued.token );
+  }
+  /* The files are added to the model in one go so that new files next to
+   * each other are inserted with one row insert. */
+  d->spellingMistakesModel->insertSpellingMistakes( updates );
+  PipelineStage* publishStage = d->pipeline.stage( Pipeline::Publish );
+  for( const CancellationToken& token: qAsConst( tokens ) ) {
+    publishStage->dequeue( token );
+  }
+  const qint64 elapsedUs = timer.nsecsElapsed() / 1000;
+  publishStage->recordBatch( elapsedUs );
+  /* Adapt the number of files of the next flush so that a flush stays
+   * within its time budget. */
+  if( elapsedUs > cPUBLISH_BUDGET_US ) {
+    d->publishBatchSize = std::max( cPUBLISH_MIN_BATCH, d->publishBatchSize / 2 );
+  } else if( ( elapsedUs < ( cPUBLISH_BUDGET_US / 2 ) )
+             && ( batchSize == d->publishBatchSize ) ) {
+    d->publishBatchSize = std::min( cPUBLISH_MAX_BATCH, d->publishBatchSize * 2 );
+  }
+#ifdef BENCH_TIME
+  qDebug() << "Publish: " << batchSize << " files"
+           << "\n  - time : " << elapsedUs << "us"
+           << "\n  - stage: " << publishStage->statistics();
+#endif /* BENCH_TIME */
+  if( d->publishOrder.isEmpty() == false ) {
+    d->publishTimer.start();
+  }
+  d->pipeline.notifyCapacity();
+}
+// --------------------------------------------------
+
+void SpellCheckerCore::startSpellCheck( const QString& fileName, const WordList& words, quint64 generation )
+{
+  /* Get the list of mistakes that were extracted on the file during the last
+   * run of the processing. */
+  WordList previousMistakes = d->spellingMistakesModel->mistakesForFile( fileName );
+  /* There is no background process processing the words for the given file.
+   * Create a processor and start processing the spelling mistakes in the
+   * background using QtConcurrent and a QFuture. */
+  SpellCheckProcessor* processor    = new SpellCheckProcessor( d->spellChecker, fileName, words, previousMistakes, generation );
+  QFutureWatcher<WordList>* watcher = new QFutureWatcher<WordList>();
+  connect( watcher, &QFutureWatcher<WordList>::finished, this, &SpellCheckerCore::futureFinished, Qt::QueuedConnection );
+  /* Keep track of the watchers that are busy and the file that it is working on.
+   * Since all QFuterWatchers are connected to the same slot, this map is used
+   * to map the correct watcher to the correct file. */
+  const FileId fileId = FileTable::id( fileName );
+  d->futureWatchers.insert( watcher, fileId );
+  d->checkedWords.insert( watcher, qMakePair( words, quint64( d->dictionaryGeneration ) ) );
+  /* This is just a convenience list to speed up checking if a file is getting
+   * processed already. An alternative would be to iterate through the above map
+   * and check where the value matches the file. This can be slow especially if
+   * there are multiple watchers running. The separate list can use indexing and
+   * other search technicians compared to the mentioned iteration search. */
+  d->filesInProcess.insert( fileId );
+  /* Make sure that the processor gets cleaned up after it has finished processing
+   * the words. */
+  connect( watcher, &QFutureWatcher<WordList>::finished, processor, &SpellCheckProcessor::deleteLater );
+
+  /* Run the processor on the Check stage of the pipeline.
+   * If the file to process is the current open editor, it is processed in a new
+   * thread with high priority so that it does not need to get queued along with
+   * all other files on the stage. */
+  const bool urgent = ( fileName == d->currentFilePath );
+  QFuture<WordList> future = d->pipeline.stage( Pipeline::Check )->run( urgent, &SpellCheckProcessor::process, processor );
+  watcher->setFuture( future );
+}
+// --------------------------------------------------
+
+void SpellCheckerCore::startWaitingSpellChecks()
+{
+  PipelineStage* checkStage = d->pipeline.stage( Pipeline::Check );
+  QHash<QString, StageWords>::iterator waitingIter = d->filesWaitingForProcess.begin();
+  while( waitingIter != d->filesWaitingForProcess.end() ) {
+    const QString fileName = waitingIter.key();
+    if( ( d->filesInProcess.contains( fileName ) == true )
+        || ( ( checkStage->canStart() == false ) && ( fileName != d->currentFilePath ) ) ) {
+      ++waitingIter;
+      continue;
+    }
+    const StageWords waiting = waitingIter.value();
+    /* remove the file and words from the scheduled list. */
+    waitingIter = d->filesWaitingForProcess.erase( waitingIter );
+    checkStage->dequeue( waiting.token );
+    startSpellCheck( fileName, waiting.words, waiting.generation );
   }
 }
 // --------------------------------------------------
@@ -415,41 +992,51 @@ void SpellCheckerCore::futureFinished()
   if( iter == d->futureWatchers.end() ) {
     return;
   }
-  QString fileName = iter.value();
+  const FileId fileId     = iter.value();
+  const QString fileName = FileTable::fileName( fileId );
   /* Remove the watcher from the list of running watchers and the file that
    * kept track of the file getting spell checked. */
   d->futureWatchers.erase( iter );
-  d->filesInProcess.removeAll( fileName );
-  /* Check if the file was scheduled for a re-check. As discussed previously,
-   * if a spell check was requested for a file that had a future already in
-   * progress, it was scheduled for a re-check as soon as the in progress one
-   * completes. If it was scheduled, restart it using the normal slot. */
-  QHash<QString, WordList>::iterator waitingIter = d->filesWaitingForProcess.find( fileName );
-  if( waitingIter != d->filesWaitingForProcess.end() ) {
-    WordList wordsToSpellCheck = waitingIter.value();
-    /* remove the file and words from the scheduled list. */
-    d->filesWaitingForProcess.erase( waitingIter );
-    locker.unlock();
-    /* Invoke the method to make sure that it gets called from the main thread.
-     * This will most probably be already in the main thread, but to make sure
-     * it is done like this. */
-    this->metaObject()->invokeMethod( this
-                                      , "spellcheckWordsFromParser"
-                                      , Qt::QueuedConnection
-                                      , Q_ARG( QString, fileName )
-                                      , Q_ARG( SpellChecker::WordList, wordsToSpellCheck ) );
-  } else {
-      locker.unlock();
+  const QPair<WordList, quint64> checked = d->checkedWords.take( watcher );
+  d->filesInProcess.remove( fileId );
+  /* If the dictionary changed while the words were checked, the mistakes
+   * might contain words that are no longer mistakes. The words are checked
+   * again, all of them since the verdicts of the parser are outdated as
+   * well, unless newer words of the file are already waiting. */
+  const bool outdated = ( checked.second != d->dictionaryGeneration );
+  if( ( outdated == true )
+      && ( d->filesWaitingForProcess.contains( fileName ) == false ) ) {
+    d->filesWaitingForProcess.insert( fileName, { checked.first, d->pipeline.stage( Pipeline::Check )->enqueue(), 0 } );
   }
+  /* Check if files were scheduled for a re-check. As discussed previously,
+   * if a spell check was requested for a file that had a future already in
+   * progress, or if the Check stage was full, it was scheduled for a re-check
+   * as soon as there is room. Start as many as the stage allows. */
+  startWaitingSpellChecks();
+  locker.unlock();
   watcher->deleteLater();
-  /* Add the list of misspelled words to the mistakes model */
-  addMisspelledWords( fileName, checkedWords );
+  if( outdated == true ) {
+    d->pipeline.notifyCapacity();
+    return;
+  }
+  /* Add the list of misspelled words to the mistakes model, or queue them
+   * to be added. */
+  publishMistakes( fileName, checkedWords );
+  /* The job left the Check stage, this can release parsers that were
+   * throttled. */
+  d->pipeline.notifyCapacity();
+  emit wordsChecked( fileName, checked.first, checkedWords, checked.second );
 }
 // --------------------------------------------------
 
 void SpellCheckerCore::cancelFutures()
 {
   QMutexLocker lock( &d->futureMutex );
+  /* Cancel the stages owned by the core first so that jobs that did not start
+   * yet return immediately. The Parse stage belongs to the parsers. */
+  d->pipeline.stage( Pipeline::Check )->cancelAll();
+  d->pipeline.stage( Pipeline::Publish )->cancelAll();
+  d->filesWaitingForProcess.clear();
   /* Iterate the futures and cancel them. */
   FutureWatcherMapIter iter = d->futureWatchers.begin();
   for( iter = d->futureWatchers.begin(); iter != d->futureWatchers.end(); ++iter ) {
@@ -462,6 +1049,22 @@ void SpellCheckerCore::cancelFutures()
     delete iter.key();
   }
   d->futureWatchers.clear();
+  d->checkedWords.clear();
+  d->filesInProcess.clear();
+  /* The same for the chunks of streamed files. */
+  for( QFutureWatcher<WordList>* watcher: d->chunkWatchers.keys() ) {
+    watcher->future().cancel();
+  }
+  for( QFutureWatcher<WordList>* watcher: d->chunkWatchers.keys() ) {
+    watcher->future().waitForFinished();
+    delete watcher;
+  }
+  d->chunkWatchers.clear();
+  d->streamedFiles.clear();
+  /* The Publish stage was cancelled, forget the results waiting on it. */
+  d->publishTimer.stop();
+  d->publishQueue.clear();
+  d->publishOrder.clear();
 }
 
 // --------------------------------------------------
@@ -490,39 +1093,34 @@ SpellCheckerCoreSettings* SpellCheckerCore::settings() const
 }
 // --------------------------------------------------
 
+SpellCheckerCore::SettingsSnapshot SpellCheckerCore::settingsSnapshot() const
+{
+  return d->settingsSnapshot.load();
+}
+// --------------------------------------------------
+
 ProjectMistakesModel* SpellCheckerCore::spellingMistakesModel() const
 {
   return d->spellingMistakesModel;
 }
 // --------------------------------------------------
 
+Pipeline* SpellCheckerCore::pipeline() const
+{
+  return &d->pipeline;
+}
+// --------------------------------------------------
+
 bool SpellCheckerCore::isWordUnderCursorMistake( Word& word ) const
 {
   if( d->currentEditor.isNull() == true ) {
     return false;
   }
 
-  int32_t column           = d->currentEditor->currentColumn();
-  int32_t line             = d->currentEditor->currentLine();
-  QString  currentFileName = d->currentEditor->document()->filePath().path();
-  WordList wl;
-  wl = d->spellingMistakesModel->mistakesForFile( currentFileName );
-  if( wl.isEmpty() == true ) {
-    return false;
-  }
-  WordList::ConstIterator iter          = wl.constBegin();
-  const WordList::ConstIterator iterEnd = wl.constEnd();
-  while( iter != iterEnd ) {
-    const Word& currentWord = iter.value();
-    if( ( currentWord.lineNumber == line )
-        && ( ( currentWord.columnNumber <= column )
-             && ( ( currentWord.columnNumber + currentWord.length ) >= column ) ) ) {
-      word = currentWord;
-      return true;
-    }
-    ++iter;
-  }
-  return false;
+  int32_t column          = d->currentEditor->currentColumn();
+  int32_t line            = d->currentEditor->currentLine();
+  QString currentFileName = d->currentEditor->document()->filePath().path();
+  return d->spellingMistakesModel->mistakeAt( currentFileName, line, column, word );
 }
 // --------------------------------------------------
 
@@ -531,22 +1129,10 @@ bool SpellCheckerCore::getAllOccurrencesOfWord( const Word& word, WordList& word
   if( d->currentEditor.isNull() == true ) {
     return false;
   }
-  WordList wl;
-  QString  currentFileName = d->currentEditor->document()->filePath().path();
-  wl = d->spellingMistakesModel->mistakesForFile( currentFileName );
-  if( wl.isEmpty() == true ) {
-    return false;
-  }
-  WordList::ConstIterator iter = wl.constBegin();
-  while( iter != wl.constEnd() ) {
-    const Word& currentWord = iter.value();
-    if( currentWord.text == word.text ) {
-      words.append( currentWord );
-    }
-    ++iter;
-  }
-  return ( wl.count() > 0 );
-
+  QString currentFileName    = d->currentEditor->document()->filePath().path();
+  const WordList occurrences = d->spellingMistakesModel->occurrencesInFile( currentFileName, word.text );
+  words.append( occurrences );
+  return ( occurrences.isEmpty() == false );
 }
 // --------------------------------------------------
 
@@ -564,7 +1150,7 @@ void SpellCheckerCore::giveSuggestionsForWordUnderCursor()
 
   getAllOccurrencesOfWord( word, wordsToReplace );
 
-  SuggestionsDialog dialog( word.text, word.suggestions, wordsToReplace.count() );
+  SuggestionsDialog dialog( word.text, word.suggestions, wordsToReplace.count(), d->spellingMistakesModel->occurrenceCountInProject( word.text ) );
   SuggestionsDialog::ReturnCode code = static_cast<SuggestionsDialog::ReturnCode>( dialog.exec() );
   switch( code ) {
     case SuggestionsDialog::Rejected:
@@ -578,6 +1164,9 @@ void SpellCheckerCore::giveSuggestionsForWordUnderCursor()
     case SuggestionsDialog::AcceptAll:
       /* Do nothing since the list of words is already valid */
       break;
+    case SuggestionsDialog::AcceptAllInProject:
+      replaceWordInProject( word.text, dialog.replacementWord() );
+      return;
   }
 
   QString replacement = dialog.replacementWord();
@@ -655,15 +1244,28 @@ void SpellCheckerCore::removeWordUnderCursor( RemoveAction action )
   }
 
   if( wordRemoved == true ) {
+    /* The verdicts that the parsers kept for their tokens are outdated. */
+    ++d->dictionaryGeneration;
     /* Remove all occurrences of the removed word. This removes the need to
      * re-parse the whole project, it will be a lot faster doing this.  */
     d->spellingMistakesModel->removeAllOccurrences( word.text );
-    /* Get the updated list associated with the file. */
+    /* Also from the mistakes that still wait to be published. */
+    for( StageWords& queued: d->publishQueue ) {
+      queued.words.remove( word.text );
+    }
+    /* And from the mistakes of the files that are being streamed. */
+    QMutexLocker locker( &d->futureMutex );
+    for( StreamedFile& stream: d->streamedFiles ) {
+      stream.baseMistakes.remove( word.text );
+      stream.mistakes.remove( word.text );
+    }
+    locker.unlock();
+    /* Get the updated list associated with the file. The project model is
+     * already up to date, only the mistakes in the output pane and the
+     * underlines in the editor must be updated. */
     WordList newList = d->spellingMistakesModel->mistakesForFile( currentFileName );
-    /* Re-add the mistakes for the file. This is at the moment a doing the same
-     * thing twice, but until the 2 mistakes models are not combined this will be
-     * needed for the mistakes in the  output pane to update. */
-    addMisspelledWords( currentFileName, newList );
+    d->mistakesModel->setCurrentSpellingMistakes( newList );
+    updateEditorSelections();
     /* Since the word is now removed from the list of spelling mistakes,
      * the word under the cursor is not a spelling mistake anymore. Notify
      * this. */
@@ -689,21 +1291,8 @@ void SpellCheckerCore::replaceWordsInCurrentEditor( const WordList& wordsToRepla
     return;
   }
 
-  QTextCursor cursor = editorWidget->textCursor();
-  /* Iterate the words and replace all one by one */
-  for( const Word& wordToReplace: wordsToReplace ) {
-    editorWidget->gotoLine( int32_t( wordToReplace.lineNumber ), int32_t( wordToReplace.columnNumber ) - 1 );
-    int wordStartPos = editorWidget->textCursor().position();
-    editorWidget->gotoLine( int32_t( wordToReplace.lineNumber ), int32_t( wordToReplace.columnNumber ) + wordToReplace.length - 1 );
-    int wordEndPos = editorWidget->textCursor().position();
-
-    cursor.beginEditBlock();
-    cursor.setPosition( wordStartPos );
-    cursor.setPosition( wordEndPos, QTextCursor::KeepAnchor );
-    cursor.removeSelectedText();
-    cursor.insertText( replacementWord );
-    cursor.endEditBlock();
-  }
+  /* Replace the words from the last to the first in one edit block. */
+  replaceWordsInDocument( editorWidget->document(), wordsToReplace, replacementWord );
   /* If more than one suggestion was replaced, show a notification */
   if( wordsToReplace.count() > 1 ) {
     Utils::FadingIndicator::showText( editorWidget,
@@ -713,6 +1302,71 @@ void SpellCheckerCore::replaceWordsInCurrentEditor( const WordList& wordsToRepla
 }
 // --------------------------------------------------
 
+void SpellCheckerCore::replaceWordInProject( const QString& wordText, const QString& replacementWord )
+{
+  QElapsedTimer timer;
+  timer.start();
+  const FileWordList occurrences = d->spellingMistakesModel->occurrencesInProject( wordText );
+  /* Files that are open are edited in their document so that the edit can be
+   * undone, the other files are patched on disk in the background. */
+  QList<QPair<QString, WordList>> closedFiles;
+  int32_t replaced = 0;
+  for( FileWordList::ConstIterator fileIter = occurrences.constBegin(); fileIter != occurrences.constEnd(); ++fileIter ) {
+    Core::IDocument* document = Core::DocumentModel::documentForFilePath( Utils::FilePath::fromString( fileIter.key() ) );
+    TextEditor::TextDocument* textDocument = qobject_cast<TextEditor::TextDocument*>( document );
+    if( textDocument != nullptr ) {
+      replaced += replaceWordsInDocument( textDocument->document(), fileIter.value(), replacementWord );
+    } else {
+      closedFiles.append( qMakePair( fileIter.key(), fileIter.value() ) );
+    }
+  }
+
+  const auto report = [wordText, replacementWord, timer, files = occurrences.size()]( int32_t count ) {
+    Core::MessageManager::writeSilently( tr( "Replaced %1 occurrences of \"%2\" with \"%3\" in %4 files in %5 ms." )
+                                         .arg( count ).arg( wordText, replacementWord ).arg( files ).arg( timer.elapsed() ) );
+  };
+  if( closedFiles.isEmpty() == true ) {
+    report( replaced );
+    return;
+  }
+
+  const auto fallbackEncoding = Core::EditorManager::defaultTextEncoding();
+  const auto replaceInFile    = [fallbackEncoding, replacementWord]( const QPair<QString, WordList>& file ) -> int32_t {
+    const Utils::FilePath filePath = Utils::FilePath::fromString( file.first );
+    Utils::TextFileFormat format;
+    QString text;
+    const Utils::TextFileFormat::ReadResult result = Utils::TextFileFormat::readFile( filePath, fallbackEncoding, &text, &format );
+    if( result.code != Utils::TextFileFormat::ReadSuccess ) {
+      return 0;
+    }
+    const int32_t count = replaceWordsInText( text, file.second, replacementWord );
+    if( ( count == 0 )
+        || ( format.writeFile( filePath, text ).has_value() == false ) ) {
+      return 0;
+    }
+    return count;
+  };
+  QFutureWatcher<int32_t>* watcher = new QFutureWatcher<int32_t>( this );
+  connect( watcher, &QFutureWatcher<int32_t>::finished, this, [watcher, closedFiles, replaced, report]() {
+    int32_t count = replaced;
+    QSet<Utils::FilePath> changedFiles;
+    for( int32_t index = 0; index < closedFiles.size(); ++index ) {
+      const int32_t fileCount = watcher->resultAt( index );
+      if( fileCount > 0 ) {
+        count += fileCount;
+        changedFiles.insert( Utils::FilePath::fromString( closedFiles.at( index ).first ) );
+      }
+    }
+    watcher->deleteLater();
+    /* Let the code model know about the files that changed on disk so that
+     * they get parsed and checked again. */
+    CppEditor::CppModelManager::updateSourceFiles( changedFiles );
+    report( count );
+  } );
+  watcher->setFuture( QtConcurrent::mapped( closedFiles, replaceInFile ) );
+}
+// --------------------------------------------------
+
 void SpellCheckerCore::startupProjectChanged( ProjectExplorer::Project* startupProject )
 {
   /* Cancel all outstanding futures */
@@ -723,8 +1377,9 @@ void SpellCheckerCore::startupProjectChanged( ProjectExplorer::Project* startupP
   if( startupProject != nullptr ) {
     /* Check if the current project is not set to be ignored by the settings. */
     if( d->settings.projectsToIgnore.contains( startupProject->displayName() ) == false ) {
-      const auto fileList = Utils::transform<QSet<QString>>( startupProject->files( ProjectExplorer::Project::SourceFiles ), &Utils::FilePath::path );
-      d->filesInStartupProject = fileList;
+      for( const Utils::FilePath& filePath: startupProject->files( ProjectExplorer::Project::SourceFiles ) ) {
+        d->filesInStartupProject.insert( FileTable::id( filePath.path() ) );
+      }
     } else {
       /* The Project should be ignored and not be spell checked. */
       d->startupProject = nullptr;
@@ -746,27 +1401,26 @@ void SpellCheckerCore::fileListChanged()
     return;
   }
 
-  const QStringSet oldFiles = d->filesInStartupProject;
-  const auto newFiles = Utils::transform<QStringSet>( d->startupProject->files( ProjectExplorer::Project::SourceFiles ), &Utils::FilePath::path );
+  FileIdSet newFiles;
+  for( const Utils::FilePath& filePath: d->startupProject->files( ProjectExplorer::Project::SourceFiles ) ) {
+    newFiles.insert( FileTable::id( filePath.path() ) );
+  }
 
   /* Compare the two sets with each other to get the lists of files
    * added and removed.
    * An implementation using std::set_difference was initially implemented
    * but that needed the set to be converted to a vector so that it can be
    * sorted, then after std::set_difference the vector was converted back
-   * to a set. This approach was in almost all tests cases slower than the
-   * current implementation.
+   * to a set. A later implementation searched each file of one set in the
+   * other, hashing all file names of both sets.
    *
-   * The current implementation relies on the fact that searching in a set
-   * is generally fast. */
-  const QStringSet added = Utils::filtered( newFiles, [&]( const QString& file ) {
-    return !oldFiles.contains( file );
-  } );
-  const QStringSet removed = Utils::filtered( oldFiles, [&]( const QString& file ) {
-    return !newFiles.contains( file );
-  } );
+   * The current implementation uses the ids of the files, the differences
+   * are taken on the bits of the sets and only the names of the files that
+   * changed are looked up. */
+  const QStringSet added   = ( newFiles - d->filesInStartupProject ).fileNames();
+  const QStringSet removed = ( d->filesInStartupProject - newFiles ).fileNames();
 
-  d->filesInStartupProject = newFiles;
+  d->filesInStartupProject = std::move( newFiles );
   /* Must let the model know about the changes since it is interested */
   d->spellingMistakesModel->projectFilesChanged( added, removed );
 
@@ -784,11 +1438,51 @@ void SpellCheckerCore::mangerEditorChanged( Core::IEditor* editor )
 
   emit currentEditorChanged( d->currentFilePath );
 
+  /* Mistakes of the new current file that are waiting in the publish queue
+   * are added now so that the editor does not show stale mistakes. */
+  WordList queued;
+  if( takeQueuedMistakes( d->currentFilePath, queued ) == true ) {
+    d->spellingMistakesModel->insertSpellingMistakes( d->currentFilePath, queued, d->filesInStartupProject.contains( d->currentFilePath ) );
+    d->pipeline.notifyCapacity();
+  }
+
   WordList wl;
   if( d->currentFilePath.isEmpty() == false ) {
     wl = d->spellingMistakesModel->mistakesForFile( d->currentFilePath );
   }
   d->mistakesModel->setCurrentSpellingMistakes( wl );
+
+  /* Follow the scrolling of the new editor so that the parsers can give the
+   * visible lines priority and the mistakes that scroll into view get
+   * underlined. */
+  disconnect( d->scrollConnection );
+  TextEditor::BaseTextEditor* baseEditor = qobject_cast<TextEditor::BaseTextEditor*>( editor );
+  if( ( baseEditor != nullptr )
+      && ( baseEditor->editorWidget() != nullptr ) ) {
+    d->scrollConnection = connect( baseEditor->editorWidget()->verticalScrollBar(), &QScrollBar::valueChanged,
+                                   &d->visibleRangeTimer, qOverload<>( &QTimer::start ) );
+    updateVisibleRange();
+  }
+
+}
+// --------------------------------------------------
+
+void SpellCheckerCore::updateVisibleRange()
+{
+  TextEditor::BaseTextEditor* baseEditor = qobject_cast<TextEditor::BaseTextEditor*>( d->currentEditor );
+  if( baseEditor == nullptr ) {
+    return;
+  }
+  TextEditor::TextEditorWidget* editorWidget = baseEditor->editorWidget();
+  if( editorWidget == nullptr ) {
+    return;
+  }
+  /* Block numbers are 0 based, lines of words are 1 based. */
+  const int32_t firstLine = editorWidget->firstVisibleBlockNumber() + 1;
+  const int32_t lastLine  = editorWidget->lastVisibleBlockNumber() + 1;
+  emit visibleRangeChanged( d->currentFilePath, firstLine, lastLine );
+  /* Underline the mistakes that scrolled into view. */
+  updateEditorSelections();
 }
 // --------------------------------------------------
 
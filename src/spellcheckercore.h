@@ -20,6 +20,8 @@
 
 #pragma once
 
+#include "SharedSnapshot.h"
+#include "spellcheckercoresettings.h"
 #include "Word.h"
 
 #include <coreplugin/editormanager/editormanager.h>
@@ -36,11 +38,11 @@ namespace SpellChecker {
 namespace Internal {
 class SpellCheckerCorePrivate;
 class OutputPane;
-class SpellCheckerCoreSettings;
 class ProjectMistakesModel;
 } // namespace Internal
 class IDocumentParser;
 class ISpellChecker;
+class Pipeline;
 
 /*!
  * \brief The SpellCheckerCore class
@@ -56,6 +58,9 @@ class SpellCheckerCore
 {
   Q_OBJECT
 public:
+  /*! \brief Immutable snapshot of the Core Settings. */
+  using SettingsSnapshot = SharedSnapshot<Internal::SpellCheckerCoreSettings>::Ptr;
+
   SpellCheckerCore( QObject* parent = nullptr );
   ~SpellCheckerCore() override;
 
@@ -98,11 +103,31 @@ public:
    * \sa addSpellChecker()
    * \sa spellChecker() */
   void setSpellChecker( ISpellChecker* spellChecker );
+  /*! \brief Generation of the dictionary of the spell checker.
+   *
+   * The generation changes each time that the verdict of the spell checker on
+   * a word can change, like when the spell checker changes or when a word is
+   * added to the dictionary or ignored. Verdicts kept by parsers are only valid
+   * for the generation that they were checked with. Thread safe. */
+  quint64 dictionaryGeneration() const;
+  /*! \brief Number of times that the words of a file did not change and
+   * checking and publishing the file was skipped. */
+  quint64 unchangedFilesSkipped() const;
 
   Core::IOptionsPage* optionsPage();
   /*! \brief Get the Core Settings. */
   Internal::SpellCheckerCoreSettings* settings() const;
+  /*! \brief Get the latest snapshot of the Core Settings.
+   *
+   * The snapshot is immutable and can be used from any thread, the generation
+   * of the snapshot changes each time that the settings change. */
+  SettingsSnapshot settingsSnapshot() const;
   Internal::ProjectMistakesModel* spellingMistakesModel() const;
+  /*! \brief Get the processing pipeline.
+   *
+   * Document parsers use the Parse stage of the pipeline to run their jobs and
+   * to apply backpressure when the later stages can not keep up. */
+  Pipeline* pipeline() const;
 
   /*! \brief Is the Word Under the Cursor a Mistake
    * Check if the word under the cursor is a spelling mistake, and if it is,
@@ -118,6 +143,16 @@ public:
    *              with.
    */
   void replaceWordsInCurrentEditor( const WordList& wordsToReplace, const QString& replacementWord );
+  /*! \brief Replace a Word in the Project.
+   *
+   * Replace all occurrences of the misspelled word in all files of the project
+   * that contain it. Open documents are edited in one edit block per document
+   * so that the replacement can be undone, files that are not open are patched
+   * on disk in parallel in the background. The number of replaced words and the
+   * time it took is written to the general messages.
+   * \param[in] wordText Misspelled word to replace.
+   * \param[in] replacementWord Word to replace the occurrences with. */
+  void replaceWordInProject( const QString& wordText, const QString& replacementWord );
 
 private:
   enum RemoveAction {
@@ -136,6 +171,36 @@ private:
    * \param[in] action Action to use to remove the word.
    */
   void removeWordUnderCursor( RemoveAction action );
+  /*! \brief Start spell checking the \a words of the given file on the Check stage.
+   *
+   * The \a generation is the generation of the dictionary that the words
+   * marked as Word::checked were judged with. The caller must hold the
+   * future mutex. */
+  void startSpellCheck( const QString& fileName, const WordList& words, quint64 generation );
+  /*! \brief Start files waiting to be spell checked while the Check stage
+   * has capacity.
+   *
+   * The caller must hold the future mutex. */
+  void startWaitingSpellChecks();
+  /*! \brief Update the underlines of the mistakes in the current editor.
+   *
+   * Selections are only created for the mistakes in and near the visible
+   * blocks of the editor. Selections that are still valid are reused and the
+   * selections on the editor are only replaced if they changed. */
+  void updateEditorSelections();
+  /*! \brief Publish the mistakes of a file that was checked.
+   *
+   * The mistakes of the current file are added immediately, the mistakes of
+   * other files are queued and added in batches by flushPublishQueue() to
+   * prevent updating the models for each file during a scan of the project.
+   * Each file in the queue is registered as waiting on the Publish stage. */
+  void publishMistakes( const QString& fileName, const WordList& words );
+  /*! \brief Remove the mistakes of a file from the publish queue.
+   *
+   * The file is completed on the Publish stage.
+   * \param[out] words The mistakes that were queued for the file.
+   * \return true if there were mistakes queued for the file. */
+  bool takeQueuedMistakes( const QString& fileName, WordList& words );
 
 signals:
   /*! \brief Signal emitted to inform the plugin if the word under the cursor is a mistake.
@@ -171,6 +236,25 @@ signals:
    * \param filesRemoved List of files removed from the project since the last
    *     notification. */
   void projectFilesChanged( QStringSet filesAdded, QStringSet filesRemoved );
+  /*! \brief Signal emitted when the visible lines of the current editor changes.
+   *
+   * The signal is emitted after the user stopped scrolling for a short while
+   * and when the current editor changes.
+   * \param filePath The file path of the current editor.
+   * \param firstLine First visible line, 1 based.
+   * \param lastLine Last visible line, 1 based. */
+  void visibleRangeChanged( const QString& filePath, int32_t firstLine, int32_t lastLine );
+  /*! \brief Signal emitted when the words of a file were checked.
+   *
+   * Parsers can keep the verdicts of the words of unchanged tokens so that
+   * those words do not have to be checked again, see Word::checked.
+   * \param fileName Name of the file that the words belong to.
+   * \param words All the words that were checked.
+   * \param mistakes The words that are spelling mistakes, with their
+   *     suggestions.
+   * \param generation Generation of the dictionary that the words were
+   *     checked with. */
+  void wordsChecked( const QString& fileName, const SpellChecker::WordList& words, const SpellChecker::WordList& mistakes, quint64 generation );
 
 public slots:
   /*! \brief Open the suggestions widget for the word under the cursor. */
@@ -202,8 +286,35 @@ private slots:
    *
    * \param[in] fileName Name of the file that the words belong to.
    * \param[in] words List of words that must be checked for spelling mistakes.
+   * \param[in] generation Generation of the dictionary that the words marked as
+   *      Word::checked were judged with.
    */
-  void spellcheckWordsFromParser( const QString& fileName, const SpellChecker::WordList& words );
+  void spellcheckWordsFromParser( const QString& fileName, const SpellChecker::WordList& words, quint64 generation );
+  /*! \brief Spellcheck a Chunk of Words from Parser
+   * Spell check a chunk of words of a file that the parser is still parsing.
+   * The mistakes of the chunks are collected and for the current file they
+   * are published as soon as a chunk was checked. When the parser commits
+   * the file with spellcheckWordsFromParser() the collected mistakes are used
+   * if all words of the file were received in chunks.
+   *
+   * \param[in] fileName Name of the file that the words belong to.
+   * \param[in] words Chunk of words that must be checked for spelling mistakes.
+   * \param[in] generation Generation of the dictionary that the words marked as
+   *      Word::checked were judged with.
+   */
+  void spellcheckWordChunkFromParser( const QString& fileName, const SpellChecker::WordList& words, quint64 generation );
+  /*! \brief Words of a File that did not change from Parser
+   * The parser reported that the words of the file did not change, the
+   * Check stage is skipped. The mistakes are only published if they moved.
+   * If the dictionary changed since the mistakes were judged, they are
+   * checked again instead.
+   *
+   * \param[in] fileName Name of the file that the mistakes belong to.
+   * \param[in] mistakes Mistakes of the file at their current positions.
+   * \param[in] generation Generation of the dictionary that the \a mistakes
+   *      were judged with.
+   */
+  void spellcheckUnchangedFromParser( const QString& fileName, const SpellChecker::WordList& mistakes, quint64 generation );
   /*! \brief Slot called when the Qt Creator Startup or active project changes. */
   void startupProjectChanged( ProjectExplorer::Project* startupProject );
   /*! \brief Slot called when the files in the project changes. */
@@ -216,6 +327,9 @@ private slots:
   void cursorPositionChanged();
   /*! \brief Slot called when the current editor changes on the editor manager. */
   void mangerEditorChanged( Core::IEditor* editor );
+  /*! \brief Slot called when the scroll timer expires to notify the parsers
+   * of the visible lines of the current editor. */
+  void updateVisibleRange();
   /*! \brief Slot called when an editor is opened. */
   void editorOpened( Core::IEditor* editor );
   /*! \brief Slot called when an editor is closed. */
@@ -230,6 +344,14 @@ private slots:
   /*! \brief Slot called when a Future is finished checking the spelling of potential
    * words. */
   void futureFinished();
+  /*! \brief Slot called when a Future is finished checking a chunk of words. */
+  void chunkFutureFinished();
+  /*! \brief Slot called by the publish timer to add queued mistakes to the
+   * models.
+   *
+   * Only as many files are added as fit in the time budget of a flush, the
+   * rest are added on the next interval. */
+  void flushPublishQueue();
   /*! \brief Slot called when the application quits to cancel all outstanding futures. */
   void cancelFutures();
   /*! \brief Slot called when Qt Creator is about to quit. */
@@ -36,6 +36,7 @@ SpellCheckerCoreSettings::SpellCheckerCoreSettings()
 SpellCheckerCoreSettings::SpellCheckerCoreSettings( const SpellCheckerCoreSettings& settings )
   : QObject( settings.parent() )
   , activeSpellChecker( settings.activeSpellChecker )
+  , underlineColor( settings.underlineColor )
   , onlyParseCurrentFile( settings.onlyParseCurrentFile )
   , checkExternalFiles( settings.checkExternalFiles )
   , projectsToIgnore( settings.projectsToIgnore )
@@ -75,15 +76,15 @@ void SpellCheckerCoreSettings::loadFromSettings( Utils::QtcSettings* settings )
 
 SpellCheckerCoreSettings& SpellCheckerCoreSettings::operator=( const SpellCheckerCoreSettings& other )
 {
-  bool settingsSame = ( operator==( other ) );
-  if( settingsSame == false ) {
+  const SettingsChanges changed = changes( other );
+  if( changed != SettingsChange::None ) {
     this->activeSpellChecker       = other.activeSpellChecker;
     this->onlyParseCurrentFile     = other.onlyParseCurrentFile;
     this->checkExternalFiles       = other.checkExternalFiles;
     this->projectsToIgnore         = other.projectsToIgnore;
     this->replaceAllFromRightClick = other.replaceAllFromRightClick;
     this->underlineColor           = other.underlineColor;
-    emit settingsChanged();
+    emit settingsChanged( changed );
   }
   return *this;
 }
@@ -101,3 +102,22 @@ bool SpellCheckerCoreSettings::operator==( const SpellCheckerCoreSettings& other
   return ( different == false );
 }
 // --------------------------------------------------
+
+SpellChecker::SettingsChanges SpellCheckerCoreSettings::changes( const SpellCheckerCoreSettings& other ) const
+{
+  SettingsChanges changed;
+  /* The color and the right click option do not change the mistakes. */
+  if( ( underlineColor != other.underlineColor )
+      || ( replaceAllFromRightClick != other.replaceAllFromRightClick ) ) {
+    changed |= SettingsChange::Render;
+  }
+  /* The rest change the spell checker or the files that are checked. */
+  if( ( activeSpellChecker != other.activeSpellChecker )
+      || ( onlyParseCurrentFile != other.onlyParseCurrentFile )
+      || ( checkExternalFiles != other.checkExternalFiles )
+      || ( projectsToIgnore != other.projectsToIgnore ) ) {
+    changed |= SettingsChange::Structural;
+  }
+  return changed;
+}
+// --------------------------------------------------
@@ -26,6 +26,27 @@
 #include <QObject>
 
 namespace SpellChecker {
+
+/*! \brief What a change of the settings affects.
+ *
+ * The settings classes report the kinds of settings that changed so that the
+ * users of the settings only redo the work that is affected by the change:
+ *  - Render: Only how the mistakes are shown or used, like the underline color.
+ *  - Filter: Which of the extracted words are checked, the filters must be
+ *      applied again to the words extracted from the tokens.
+ *  - Extraction: Which tokens are extracted, only the tokens of the kinds that
+ *      are now checked must be extracted.
+ *  - Structural: Anything else, like the files that are checked. Everything
+ *      must be done again. */
+enum class SettingsChange {
+  None       = 0,
+  Render     = 1 << 0,
+  Filter     = 1 << 1,
+  Extraction = 1 << 2,
+  Structural = 1 << 3
+};
+Q_DECLARE_FLAGS( SettingsChanges, SettingsChange )
+
 namespace Internal {
 
 class SpellCheckerCoreSettings
@@ -42,6 +63,8 @@ public:
 
   SpellCheckerCoreSettings& operator=( const SpellCheckerCoreSettings& other );
   bool operator==( const SpellCheckerCoreSettings& other ) const;
+  /*! \brief Get the kinds of settings that are different in \a other. */
+  SettingsChanges changes( const SpellCheckerCoreSettings& other ) const;
 
   QString activeSpellChecker;
   QColor underlineColor{ Qt::red };
@@ -53,9 +76,13 @@ public:
   bool replaceAllFromRightClick;
 
 signals:
-  void settingsChanged();
+  /*! \brief Signal emitted when the settings changed.
+   * \param changes Kinds of settings that changed. */
+  void settingsChanged( SpellChecker::SettingsChanges changes );
 
 };
 
 } // namespace Internal
 } // namespace SpellChecker
+
+Q_DECLARE_OPERATORS_FOR_FLAGS( SpellChecker::SettingsChanges )
@@ -25,7 +25,7 @@
 
 using namespace SpellChecker::Internal;
 
-SuggestionsDialog::SuggestionsDialog( const QString& word, const QStringList& suggestions, qint32 occurrences, QWidget* parent )
+SuggestionsDialog::SuggestionsDialog( const QString& word, const QStringList& suggestions, qint32 occurrences, qint32 projectOccurrences, QWidget* parent )
   : QDialog( parent )
   , ui( new Ui::SuggestionsDialog )
 {
@@ -36,6 +36,7 @@ SuggestionsDialog::SuggestionsDialog( const QString& word, const QStringList& su
   connect( ui->listWidgetSuggestions, &QListWidget::currentTextChanged, this, &SuggestionsDialog::listWidgetSuggestionsCurrentTextChanged );
   connect( ui->pushButtonReplace,     &QPushButton::clicked,            this, &SuggestionsDialog::pushButtonReplaceClicked );
   connect( ui->pushButtonReplaceAll,  &QPushButton::clicked,            this, &SuggestionsDialog::pushButtonReplaceAllClicked );
+  connect( ui->pushButtonReplaceInProject, &QPushButton::clicked,       this, &SuggestionsDialog::pushButtonReplaceInProjectClicked );
   connect( ui->pushButtonCancel,      &QPushButton::clicked,            this, &SuggestionsDialog::pushButtonCancelClicked );
 
   ui->lineEditWord->setText( word );
@@ -50,6 +51,12 @@ SuggestionsDialog::SuggestionsDialog( const QString& word, const QStringList& su
   } else {
     ui->pushButtonReplaceAll->setVisible( false );
   }
+  /* Only offer to replace in the project if the word is in other files. */
+  if( projectOccurrences > occurrences ) {
+    ui->pushButtonReplaceInProject->setText( ui->pushButtonReplaceInProject->text().replace( QLatin1String( "xxx" ), QString::number( projectOccurrences ) ) );
+  } else {
+    ui->pushButtonReplaceInProject->setVisible( false );
+  }
 }
 // --------------------------------------------------
 
@@ -83,6 +90,7 @@ void SpellChecker::Internal::SuggestionsDialog::lineEditReplacementTextChanged(
    * word with */
   ui->pushButtonReplace->setEnabled( arg1.isEmpty() == false );
   ui->pushButtonReplaceAll->setEnabled( arg1.isEmpty() == false );
+  ui->pushButtonReplaceInProject->setEnabled( arg1.isEmpty() == false );
 }
 // --------------------------------------------------
 
@@ -105,6 +113,12 @@ void SpellChecker::Internal::SuggestionsDialog::pushButtonReplaceAllClicked()
 }
 // --------------------------------------------------
 
+void SpellChecker::Internal::SuggestionsDialog::pushButtonReplaceInProjectClicked()
+{
+  done( AcceptAllInProject );
+}
+// --------------------------------------------------
+
 void SpellChecker::Internal::SuggestionsDialog::pushButtonCancelClicked()
 {
   reject();
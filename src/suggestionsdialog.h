@@ -34,14 +34,15 @@ class SuggestionsDialog
   Q_OBJECT
 
 public:
-  explicit SuggestionsDialog( const QString& word, const QStringList& suggestions, qint32 occurrences, QWidget* parent = nullptr );
+  explicit SuggestionsDialog( const QString& word, const QStringList& suggestions, qint32 occurrences, qint32 projectOccurrences = 0, QWidget* parent = nullptr );
   QString replacementWord() const;
   ~SuggestionsDialog() override;
 
   enum ReturnCode {
     Rejected = DialogCode::Rejected,
     Accepted = DialogCode::Accepted,
-    AcceptAll /*!< Accept and Replace All. */
+    AcceptAll,         /*!< Accept and Replace All. */
+    AcceptAllInProject /*!< Accept and Replace All in the Project. */
   };
 
 private slots:
@@ -50,6 +51,7 @@ private slots:
   void listWidgetSuggestionsCurrentTextChanged( const QString& currentText );
   void pushButtonReplaceClicked();
   void pushButtonReplaceAllClicked();
+  void pushButtonReplaceInProjectClicked();
   void pushButtonCancelClicked();
 
 private: